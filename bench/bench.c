@@ -0,0 +1,1019 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+
+#ifndef NORA_BENCH_COMPOSITOR
+#define NORA_BENCH_COMPOSITOR "nora"
+#endif
+
+#define BENCH_BUFFER_WIDTH 64
+#define BENCH_BUFFER_HEIGHT 64
+#define BENCH_BUFFER_STRIDE (BENCH_BUFFER_WIDTH * 4)
+#define BENCH_BUFFER_SIZE (BENCH_BUFFER_STRIDE * BENCH_BUFFER_HEIGHT)
+
+static const char usage[] =
+    "Usage: nora-bench [options]\n"
+    "\n"
+    "Runs nora on the headless backend with pixman rendering and measures it\n"
+    "under load from synthetic xdg-toplevel clients committing shm buffers.\n"
+    "\n"
+    "  -h, --help                Show this help message.\n"
+    "  -c, --compositor <path>   Compositor to run. Default: the nora built\n"
+    "                            alongside.\n"
+    "  -n, --windows <n,...>     Window counts to measure. Default: 10,100,500\n"
+    "  -r, --rate <hz>           Commit rate of every client. Default: 60\n"
+    "  -d, --duration <s>        Measured seconds per window count, after one\n"
+    "                            second of warmup. Default: 5\n"
+    "  -p, --popups <n>          Instead, open and close <n> popups on one\n"
+    "                            window, one after the other. Reports the\n"
+    "                            round trip of each and the compositor's\n"
+    "                            memory in ten slices.\n"
+    "  -b, --dmabuf <renderer>   Instead, run nora with <renderer> and check\n"
+    "                            the buffer types it advertises: shm only for\n"
+    "                            pixman, otherwise zwp_linux_dmabuf_v1 with a\n"
+    "                            usable default feedback. Skipped if nora\n"
+    "                            cannot start with <renderer>.\n";
+
+struct bench_buffer {
+  struct wl_buffer *wl_buffer;
+  bool busy;
+};
+
+struct bench_client {
+  struct bench *bench;
+
+  struct wl_display *display;
+  struct wl_compositor *compositor;
+  struct wl_shm *shm;
+  struct xdg_wm_base *wm_base;
+  struct zwp_linux_dmabuf_v1 *linux_dmabuf;
+
+  struct wl_surface *surface;
+  struct xdg_surface *xdg_surface;
+  struct xdg_toplevel *xdg_toplevel;
+  struct bench_buffer buffers[2];
+
+  bool configured;
+  bool frame_pending;
+  int64_t commit_nsec;
+  uint64_t frames;
+};
+
+struct bench {
+  const char *compositor;
+  const char *renderer;
+  char runtime_dir[64];
+  pid_t pid;
+
+  struct bench_client *clients;
+  size_t client_count;
+
+  // Commit to frame callback, in nanoseconds.
+  int64_t *latencies;
+  size_t latency_count, latency_capacity;
+  bool measuring;
+};
+
+static int64_t now_nsec(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void bench_record_latency(struct bench *bench, int64_t latency) {
+  if (!bench->measuring) {
+    return;
+  }
+
+  if (bench->latency_count == bench->latency_capacity) {
+    size_t capacity =
+        bench->latency_capacity == 0 ? 4096 : bench->latency_capacity * 2;
+    int64_t *latencies =
+        realloc(bench->latencies, capacity * sizeof(*latencies));
+    if (latencies == NULL) {
+      return;
+    }
+
+    bench->latencies = latencies;
+    bench->latency_capacity = capacity;
+  }
+
+  bench->latencies[bench->latency_count++] = latency;
+}
+
+/* Synthetic clients
+ */
+
+static void on_buffer_release(void *data, struct wl_buffer *wl_buffer) {
+  struct bench_buffer *buffer = data;
+  buffer->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+    .release = on_buffer_release,
+};
+
+static void on_frame_done(void *data, struct wl_callback *callback,
+                          uint32_t time) {
+  struct bench_client *client = data;
+  wl_callback_destroy(callback);
+
+  client->frame_pending = false;
+  client->frames++;
+  bench_record_latency(client->bench, now_nsec() - client->commit_nsec);
+}
+
+static const struct wl_callback_listener frame_listener = {
+    .done = on_frame_done,
+};
+
+static void on_wm_base_ping(void *data, struct xdg_wm_base *wm_base,
+                            uint32_t serial) {
+  xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+    .ping = on_wm_base_ping,
+};
+
+static void on_xdg_surface_configure(void *data,
+                                     struct xdg_surface *xdg_surface,
+                                     uint32_t serial) {
+  struct bench_client *client = data;
+  xdg_surface_ack_configure(xdg_surface, serial);
+  client->configured = true;
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+    .configure = on_xdg_surface_configure,
+};
+
+static void on_xdg_toplevel_configure(void *data,
+                                      struct xdg_toplevel *xdg_toplevel,
+                                      int32_t width, int32_t height,
+                                      struct wl_array *states) {}
+
+static void on_xdg_toplevel_close(void *data,
+                                  struct xdg_toplevel *xdg_toplevel) {}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+    .configure = on_xdg_toplevel_configure,
+    .close = on_xdg_toplevel_close,
+};
+
+static void on_popup_surface_configure(void *data,
+                                       struct xdg_surface *xdg_surface,
+                                       uint32_t serial) {
+  bool *configured = data;
+  xdg_surface_ack_configure(xdg_surface, serial);
+  *configured = true;
+}
+
+static const struct xdg_surface_listener popup_surface_listener = {
+    .configure = on_popup_surface_configure,
+};
+
+static void on_popup_configure(void *data, struct xdg_popup *xdg_popup,
+                               int32_t x, int32_t y, int32_t width,
+                               int32_t height) {}
+
+static void on_popup_done(void *data, struct xdg_popup *xdg_popup) {}
+
+static void on_popup_repositioned(void *data, struct xdg_popup *xdg_popup,
+                                  uint32_t token) {}
+
+static const struct xdg_popup_listener popup_listener = {
+    .configure = on_popup_configure,
+    .popup_done = on_popup_done,
+    .repositioned = on_popup_repositioned,
+};
+
+static void on_registry_global(void *data, struct wl_registry *registry,
+                               uint32_t name, const char *interface,
+                               uint32_t version) {
+  struct bench_client *client = data;
+
+  if (strcmp(interface, wl_compositor_interface.name) == 0) {
+    client->compositor =
+        wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+  } else if (strcmp(interface, wl_shm_interface.name) == 0) {
+    client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+  } else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+    client->wm_base =
+        wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+    xdg_wm_base_add_listener(client->wm_base, &wm_base_listener, client);
+  } else if (strcmp(interface, zwp_linux_dmabuf_v1_interface.name) == 0 &&
+             version >= 4) {
+    // Only version 4 and up have the feedback, older ones get nothing.
+    client->linux_dmabuf =
+        wl_registry_bind(registry, name, &zwp_linux_dmabuf_v1_interface, 4);
+  }
+}
+
+static void on_registry_global_remove(void *data, struct wl_registry *registry,
+                                      uint32_t name) {}
+
+static const struct wl_registry_listener registry_listener = {
+    .global = on_registry_global,
+    .global_remove = on_registry_global_remove,
+};
+
+static bool bench_client_create_buffers(struct bench_client *client,
+                                        uint32_t color) {
+  size_t size = BENCH_BUFFER_SIZE * 2;
+
+  int fd = memfd_create("nora-bench", MFD_CLOEXEC);
+  if (fd < 0 || ftruncate(fd, size) < 0) {
+    perror("failed to create shm pool");
+    return false;
+  }
+
+  uint32_t *pixels =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (pixels == MAP_FAILED) {
+    perror("failed to map shm pool");
+    close(fd);
+    return false;
+  }
+
+  // The second buffer is a shade darker, so every commit changes content.
+  for (size_t i = 0; i < size / 4; ++i) {
+    pixels[i] = i < BENCH_BUFFER_SIZE / 4 ? color : (color >> 1) & 0xff7f7f7f;
+  }
+  munmap(pixels, size);
+
+  struct wl_shm_pool *pool = wl_shm_create_pool(client->shm, fd, size);
+  for (size_t i = 0; i < 2; ++i) {
+    client->buffers[i].wl_buffer = wl_shm_pool_create_buffer(
+        pool, i * BENCH_BUFFER_SIZE, BENCH_BUFFER_WIDTH, BENCH_BUFFER_HEIGHT,
+        BENCH_BUFFER_STRIDE, WL_SHM_FORMAT_ARGB8888);
+    wl_buffer_add_listener(client->buffers[i].wl_buffer, &buffer_listener,
+                           &client->buffers[i]);
+  }
+  wl_shm_pool_destroy(pool);
+  close(fd);
+
+  return true;
+}
+
+static bool bench_client_init(struct bench *bench, struct bench_client *client,
+                              size_t index) {
+  client->bench = bench;
+  client->display = wl_display_connect(NULL);
+  if (client->display == NULL) {
+    fprintf(stderr, "client %zu: failed to connect\n", index);
+    return false;
+  }
+
+  struct wl_registry *registry = wl_display_get_registry(client->display);
+  wl_registry_add_listener(registry, &registry_listener, client);
+  wl_display_roundtrip(client->display);
+  wl_registry_destroy(registry);
+
+  if (client->compositor == NULL || client->shm == NULL ||
+      client->wm_base == NULL) {
+    fprintf(stderr, "client %zu: missing globals\n", index);
+    return false;
+  }
+
+  if (!bench_client_create_buffers(client, 0xff000000 | (index * 0x9e3779))) {
+    return false;
+  }
+
+  client->surface = wl_compositor_create_surface(client->compositor);
+  client->xdg_surface =
+      xdg_wm_base_get_xdg_surface(client->wm_base, client->surface);
+  xdg_surface_add_listener(client->xdg_surface, &xdg_surface_listener, client);
+  client->xdg_toplevel = xdg_surface_get_toplevel(client->xdg_surface);
+  xdg_toplevel_add_listener(client->xdg_toplevel, &xdg_toplevel_listener,
+                            client);
+  xdg_toplevel_set_app_id(client->xdg_toplevel, "nora-bench");
+  wl_surface_commit(client->surface);
+
+  while (!client->configured) {
+    if (wl_display_dispatch(client->display) < 0) {
+      fprintf(stderr, "client %zu: disconnected before configure\n", index);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void bench_client_finish(struct bench_client *client) {
+  if (client->display == NULL) {
+    return;
+  }
+
+  // Closing the connection makes the compositor clean up everything else.
+  wl_display_disconnect(client->display);
+  client->display = NULL;
+}
+
+static void bench_client_commit(struct bench_client *client) {
+  if (!client->configured || client->frame_pending) {
+    return;
+  }
+
+  struct bench_buffer *buffer = NULL;
+  for (size_t i = 0; i < 2; ++i) {
+    if (!client->buffers[i].busy &&
+        (buffer == NULL || client->frames % 2 == i)) {
+      buffer = &client->buffers[i];
+    }
+  }
+  if (buffer == NULL) {
+    return;
+  }
+
+  buffer->busy = true;
+  wl_surface_attach(client->surface, buffer->wl_buffer, 0, 0);
+  wl_surface_damage_buffer(client->surface, 0, 0, BENCH_BUFFER_WIDTH,
+                           BENCH_BUFFER_HEIGHT);
+
+  struct wl_callback *callback = wl_surface_frame(client->surface);
+  wl_callback_add_listener(callback, &frame_listener, client);
+
+  client->frame_pending = true;
+  client->commit_nsec = now_nsec();
+  wl_surface_commit(client->surface);
+}
+
+/* Compositor
+ */
+
+static bool bench_spawn_compositor(struct bench *bench) {
+  snprintf(bench->runtime_dir, sizeof(bench->runtime_dir),
+           "/tmp/nora-bench-XXXXXX");
+  if (mkdtemp(bench->runtime_dir) == NULL) {
+    perror("failed to create runtime directory");
+    return false;
+  }
+
+  // A fresh runtime directory makes the compositor pick wayland-0.
+  setenv("XDG_RUNTIME_DIR", bench->runtime_dir, 1);
+  setenv("WAYLAND_DISPLAY", "wayland-0", 1);
+
+  bench->pid = fork();
+  if (bench->pid < 0) {
+    perror("fork failed");
+    return false;
+  }
+
+  if (bench->pid == 0) {
+    setenv("WLR_BACKENDS", "headless", 1);
+    setenv("WLR_RENDERER", bench->renderer, 1);
+    setenv("WLR_HEADLESS_OUTPUTS", "1", 1);
+    setenv("WLR_LIBINPUT_NO_DEVICES", "1", 1);
+    unsetenv("WAYLAND_DISPLAY");
+    unsetenv("DISPLAY");
+
+    // The compositor logs at debug level, keep the report readable.
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0) {
+      dup2(null, STDERR_FILENO);
+      dup2(null, STDOUT_FILENO);
+    }
+
+    execlp(bench->compositor, bench->compositor, (char *)NULL);
+    _exit(127);
+  }
+
+  char socket[128];
+  snprintf(socket, sizeof(socket), "%s/wayland-0", bench->runtime_dir);
+  for (int i = 0; i < 500; ++i) {
+    struct stat st;
+    if (stat(socket, &st) == 0) {
+      return true;
+    }
+
+    if (waitpid(bench->pid, NULL, WNOHANG) == bench->pid) {
+      fprintf(stderr, "%s exited during startup\n", bench->compositor);
+      bench->pid = 0;
+      return false;
+    }
+
+    usleep(10000);
+  }
+
+  fprintf(stderr, "%s did not create its socket\n", bench->compositor);
+  return false;
+}
+
+static void bench_kill_compositor(struct bench *bench) {
+  if (bench->pid > 0) {
+    kill(bench->pid, SIGTERM);
+    waitpid(bench->pid, NULL, 0);
+    bench->pid = 0;
+  }
+
+  char socket[128];
+  snprintf(socket, sizeof(socket), "%s/wayland-0", bench->runtime_dir);
+  unlink(socket);
+  snprintf(socket, sizeof(socket), "%s/wayland-0.lock", bench->runtime_dir);
+  unlink(socket);
+  rmdir(bench->runtime_dir);
+}
+
+// Returns the user and system CPU time of the process in nanoseconds.
+static int64_t process_cpu_nsec(pid_t pid) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return 0;
+  }
+
+  char line[1024];
+  char *read = fgets(line, sizeof(line), file);
+  fclose(file);
+  if (read == NULL) {
+    return 0;
+  }
+
+  // The command name may contain spaces, the fields start after it.
+  char *fields = strrchr(line, ')');
+  if (fields == NULL) {
+    return 0;
+  }
+
+  unsigned long utime, stime;
+  if (sscanf(fields + 2,
+             "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime,
+             &stime) != 2) {
+    return 0;
+  }
+
+  return (int64_t)(utime + stime) * 1000000000 / sysconf(_SC_CLK_TCK);
+}
+
+// Returns a field of /proc/<pid>/status in KiB, e.g. VmRSS.
+static long process_status_kib(pid_t pid, const char *field) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/status", pid);
+
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return 0;
+  }
+
+  long value = 0;
+  char line[256];
+  size_t length = strlen(field);
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (strncmp(line, field, length) == 0 && line[length] == ':') {
+      value = strtol(line + length + 1, NULL, 10);
+      break;
+    }
+  }
+
+  fclose(file);
+  return value;
+}
+
+/* Driver
+ */
+
+static int compare_int64(const void *a, const void *b) {
+  int64_t x = *(const int64_t *)a;
+  int64_t y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static bool bench_pump(struct bench *bench, int timer_fd, int64_t until) {
+  size_t count = bench->client_count + 1;
+  struct pollfd *fds = calloc(count, sizeof(*fds));
+  if (fds == NULL) {
+    return false;
+  }
+
+  fds[0] = (struct pollfd){.fd = timer_fd, .events = POLLIN};
+  for (size_t i = 0; i < bench->client_count; ++i) {
+    fds[i + 1] = (struct pollfd){
+        .fd = wl_display_get_fd(bench->clients[i].display),
+        .events = POLLIN,
+    };
+  }
+
+  bool ok = true;
+  while (ok && now_nsec() < until) {
+    for (size_t i = 0; i < bench->client_count; ++i) {
+      wl_display_flush(bench->clients[i].display);
+    }
+
+    if (poll(fds, count, 100) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("poll failed");
+      ok = false;
+      break;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      uint64_t expirations;
+      if (read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+        for (size_t i = 0; i < bench->client_count; ++i) {
+          bench_client_commit(&bench->clients[i]);
+        }
+      }
+    }
+
+    for (size_t i = 0; i < bench->client_count; ++i) {
+      if (fds[i + 1].revents & (POLLERR | POLLHUP)) {
+        fprintf(stderr, "client %zu: disconnected\n", i);
+        ok = false;
+        break;
+      }
+
+      if ((fds[i + 1].revents & POLLIN) &&
+          wl_display_dispatch(bench->clients[i].display) < 0) {
+        fprintf(stderr, "client %zu: protocol error\n", i);
+        ok = false;
+        break;
+      }
+    }
+  }
+
+  free(fds);
+  return ok;
+}
+
+static bool bench_run(struct bench *bench, size_t windows, uint32_t rate,
+                      uint32_t duration) {
+  if (!bench_spawn_compositor(bench)) {
+    bench_kill_compositor(bench);
+    return false;
+  }
+
+  bool ok = false;
+  bench->clients = calloc(windows, sizeof(*bench->clients));
+  bench->client_count = 0;
+  bench->latency_count = 0;
+  bench->measuring = false;
+
+  int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (bench->clients == NULL || timer_fd < 0) {
+    goto out;
+  }
+
+  for (size_t i = 0; i < windows; ++i) {
+    bench->client_count++;
+    if (!bench_client_init(bench, &bench->clients[i], i)) {
+      goto out;
+    }
+  }
+
+  long interval = 1000000000L / rate;
+  struct itimerspec spec = {
+      .it_interval = {.tv_sec = interval / 1000000000L,
+                      .tv_nsec = interval % 1000000000L},
+      .it_value = {.tv_sec = interval / 1000000000L,
+                   .tv_nsec = interval % 1000000000L},
+  };
+  timerfd_settime(timer_fd, 0, &spec, NULL);
+
+  // Let mapping and the first frames settle before measuring.
+  if (!bench_pump(bench, timer_fd, now_nsec() + 1000000000L)) {
+    goto out;
+  }
+
+  bench->measuring = true;
+  uint64_t frames_start = bench->clients[0].frames;
+  int64_t cpu_start = process_cpu_nsec(bench->pid);
+  int64_t start = now_nsec();
+
+  if (!bench_pump(bench, timer_fd,
+                  start + (int64_t)duration * 1000000000L)) {
+    goto out;
+  }
+
+  int64_t elapsed = now_nsec() - start;
+  int64_t cpu = process_cpu_nsec(bench->pid) - cpu_start;
+  // Every client is mapped on the one headless output, so the first client
+  // gets a frame callback for each output frame it took part in.
+  uint64_t frames = bench->clients[0].frames - frames_start;
+  long rss = process_status_kib(bench->pid, "VmRSS");
+  long hwm = process_status_kib(bench->pid, "VmHWM");
+
+  int64_t p50 = 0, p99 = 0;
+  if (bench->latency_count > 0) {
+    qsort(bench->latencies, bench->latency_count, sizeof(*bench->latencies),
+          compare_int64);
+    p50 = bench->latencies[(bench->latency_count - 1) * 50 / 100];
+    p99 = bench->latencies[(bench->latency_count - 1) * 99 / 100];
+  }
+
+  printf("%7zu %8" PRIu64 " %10.1f %8.1f %9.2f %9.2f %9.1f %9.1f\n", windows,
+         frames, frames > 0 ? cpu / 1000.0 / frames : 0.0,
+         cpu * 100.0 / elapsed, p50 / 1000000.0, p99 / 1000000.0,
+         rss / 1024.0, hwm / 1024.0);
+  fflush(stdout);
+  ok = true;
+
+out:
+  if (timer_fd >= 0) {
+    close(timer_fd);
+  }
+  for (size_t i = 0; i < bench->client_count; ++i) {
+    bench_client_finish(&bench->clients[i]);
+  }
+  free(bench->clients);
+  bench->clients = NULL;
+  bench->client_count = 0;
+
+  bench_kill_compositor(bench);
+  return ok;
+}
+
+// Opens a popup on the client's window, maps it and closes it again. Returns
+// false if the connection broke.
+static bool bench_client_churn_popup(struct bench_client *client) {
+  bool configured = false;
+
+  struct wl_surface *surface = wl_compositor_create_surface(client->compositor);
+  struct xdg_surface *xdg_surface =
+      xdg_wm_base_get_xdg_surface(client->wm_base, surface);
+  xdg_surface_add_listener(xdg_surface, &popup_surface_listener, &configured);
+
+  struct xdg_positioner *positioner =
+      xdg_wm_base_create_positioner(client->wm_base);
+  xdg_positioner_set_size(positioner, BENCH_BUFFER_WIDTH / 2,
+                          BENCH_BUFFER_HEIGHT / 2);
+  xdg_positioner_set_anchor_rect(positioner, 0, 0, 1, 1);
+
+  struct xdg_popup *xdg_popup =
+      xdg_surface_get_popup(xdg_surface, client->xdg_surface, positioner);
+  xdg_popup_add_listener(xdg_popup, &popup_listener, NULL);
+  xdg_positioner_destroy(positioner);
+  wl_surface_commit(surface);
+
+  while (!configured) {
+    if (wl_display_dispatch(client->display) < 0) {
+      return false;
+    }
+  }
+
+  // A wl_buffer may be attached to any number of surfaces.
+  wl_surface_attach(surface, client->buffers[1].wl_buffer, 0, 0);
+  wl_surface_damage_buffer(surface, 0, 0, BENCH_BUFFER_WIDTH / 2,
+                           BENCH_BUFFER_HEIGHT / 2);
+  wl_surface_commit(surface);
+
+  xdg_popup_destroy(xdg_popup);
+  xdg_surface_destroy(xdg_surface);
+  wl_surface_destroy(surface);
+
+  return wl_display_roundtrip(client->display) >= 0;
+}
+
+static bool bench_run_popups(struct bench *bench, size_t popups) {
+  if (!bench_spawn_compositor(bench)) {
+    bench_kill_compositor(bench);
+    return false;
+  }
+
+  bool ok = false;
+  struct bench_client client = {0};
+  bench->latency_count = 0;
+  bench->measuring = true;
+
+  if (!bench_client_init(bench, &client, 0)) {
+    goto out;
+  }
+
+  // Map the parent window first.
+  bench_client_commit(&client);
+  if (wl_display_roundtrip(client.display) < 0) {
+    goto out;
+  }
+
+  printf("%8s %10s %9s %9s %10s %9s\n", "cycles", "popups/s", "rtt p50",
+         "rtt p99", "cpu/popup", "rss");
+  printf("%8s %10s %9s %9s %10s %9s\n", "", "", "(us)", "(us)", "(us)",
+         "(KiB)");
+
+  /* Report in ten slices, a leak shows up as a growing rss and slower
+   * roundtrips from one slice to the next. */
+  size_t slice = popups >= 10 ? popups / 10 : popups;
+  for (size_t done = 0; done < popups;) {
+    size_t count = popups - done < slice ? popups - done : slice;
+
+    bench->latency_count = 0;
+    int64_t cpu_start = process_cpu_nsec(bench->pid);
+    int64_t start = now_nsec();
+
+    for (size_t i = 0; i < count; ++i) {
+      int64_t popup_start = now_nsec();
+      if (!bench_client_churn_popup(&client)) {
+        fprintf(stderr, "popup %zu: disconnected\n", done + i);
+        goto out;
+      }
+      bench_record_latency(bench, now_nsec() - popup_start);
+    }
+
+    done += count;
+    int64_t elapsed = now_nsec() - start;
+    int64_t cpu = process_cpu_nsec(bench->pid) - cpu_start;
+    long rss = process_status_kib(bench->pid, "VmRSS");
+
+    int64_t p50 = 0, p99 = 0;
+    if (bench->latency_count > 0) {
+      qsort(bench->latencies, bench->latency_count,
+            sizeof(*bench->latencies), compare_int64);
+      p50 = bench->latencies[(bench->latency_count - 1) * 50 / 100];
+      p99 = bench->latencies[(bench->latency_count - 1) * 99 / 100];
+    }
+
+    printf("%8zu %10.0f %9.1f %9.1f %10.1f %9ld\n", done,
+           count * 1e9 / elapsed, p50 / 1000.0, p99 / 1000.0,
+           cpu / 1000.0 / count, rss);
+    fflush(stdout);
+  }
+
+  ok = true;
+
+out:
+  bench_client_finish(&client);
+  bench_kill_compositor(bench);
+  return ok;
+}
+
+// What the default feedback of zwp_linux_dmabuf_v1 carried until its done.
+struct bench_dmabuf_feedback {
+  bool done;
+  uint32_t table_entries;
+  bool main_device;
+  size_t tranches;
+  size_t formats;
+  // Format indices past the end of the table.
+  size_t invalid_formats;
+};
+
+static void on_feedback_done(void *data,
+                             struct zwp_linux_dmabuf_feedback_v1 *feedback) {
+  struct bench_dmabuf_feedback *state = data;
+  state->done = true;
+}
+
+static void
+on_feedback_format_table(void *data,
+                         struct zwp_linux_dmabuf_feedback_v1 *feedback,
+                         int32_t fd, uint32_t size) {
+  struct bench_dmabuf_feedback *state = data;
+
+  // Every entry is a 32-bit format, 32 bits of padding and a 64-bit modifier.
+  state->table_entries = size / 16;
+  close(fd);
+}
+
+static void
+on_feedback_main_device(void *data,
+                        struct zwp_linux_dmabuf_feedback_v1 *feedback,
+                        struct wl_array *device) {
+  struct bench_dmabuf_feedback *state = data;
+  state->main_device = device->size == sizeof(dev_t);
+}
+
+static void
+on_feedback_tranche_done(void *data,
+                         struct zwp_linux_dmabuf_feedback_v1 *feedback) {
+  struct bench_dmabuf_feedback *state = data;
+  state->tranches++;
+}
+
+static void on_feedback_tranche_target_device(
+    void *data, struct zwp_linux_dmabuf_feedback_v1 *feedback,
+    struct wl_array *device) {}
+
+static void
+on_feedback_tranche_formats(void *data,
+                            struct zwp_linux_dmabuf_feedback_v1 *feedback,
+                            struct wl_array *indices) {
+  struct bench_dmabuf_feedback *state = data;
+
+  uint16_t *index;
+  wl_array_for_each(index, indices) {
+    state->formats++;
+    if (*index >= state->table_entries) {
+      state->invalid_formats++;
+    }
+  }
+}
+
+static void
+on_feedback_tranche_flags(void *data,
+                          struct zwp_linux_dmabuf_feedback_v1 *feedback,
+                          uint32_t flags) {}
+
+static const struct zwp_linux_dmabuf_feedback_v1_listener feedback_listener = {
+    .done = on_feedback_done,
+    .format_table = on_feedback_format_table,
+    .main_device = on_feedback_main_device,
+    .tranche_done = on_feedback_tranche_done,
+    .tranche_target_device = on_feedback_tranche_target_device,
+    .tranche_formats = on_feedback_tranche_formats,
+    .tranche_flags = on_feedback_tranche_flags,
+};
+
+/* Checks the buffer types nora advertises with bench->renderer. Pixman
+ * cannot import dmabufs, so nora must offer shm only; with any other
+ * renderer the default feedback has to name the main device and at least
+ * one format. Returns 0 on success, 1 on failure and 77, meson's exit code
+ * for a skipped test, if nora does not start with the renderer. */
+static int bench_run_dmabuf(struct bench *bench) {
+  bool pixman = strcmp(bench->renderer, "pixman") == 0;
+  if (!bench_spawn_compositor(bench)) {
+    bool started = bench->pid > 0;
+    bench_kill_compositor(bench);
+    if (!started && !pixman) {
+      fprintf(stderr, "%s: no %s renderer here, skipped\n", bench->compositor,
+              bench->renderer);
+      return 77;
+    }
+    return 1;
+  }
+
+  int ret = 1;
+  struct bench_client client = {0};
+  struct zwp_linux_dmabuf_feedback_v1 *feedback = NULL;
+
+  if (!bench_client_init(bench, &client, 0)) {
+    goto out;
+  }
+
+  if (pixman) {
+    if (client.linux_dmabuf != NULL) {
+      fprintf(stderr, "pixman: zwp_linux_dmabuf_v1 is advertised\n");
+      goto out;
+    }
+
+    printf("%s: shm only\n", bench->renderer);
+    ret = 0;
+    goto out;
+  }
+
+  if (client.linux_dmabuf == NULL) {
+    fprintf(stderr, "%s: zwp_linux_dmabuf_v1 version 4 is not advertised\n",
+            bench->renderer);
+    goto out;
+  }
+
+  struct bench_dmabuf_feedback state = {0};
+  int64_t start = now_nsec();
+  feedback = zwp_linux_dmabuf_v1_get_default_feedback(client.linux_dmabuf);
+  zwp_linux_dmabuf_feedback_v1_add_listener(feedback, &feedback_listener,
+                                            &state);
+  while (!state.done) {
+    if (wl_display_dispatch(client.display) < 0) {
+      fprintf(stderr, "%s: disconnected before the feedback was done\n",
+              bench->renderer);
+      goto out;
+    }
+  }
+  int64_t elapsed = now_nsec() - start;
+
+  printf("%10s %8s %8s %8s\n", "renderer", "tranches", "formats", "feedback");
+  printf("%10s %8s %8s %8s\n", "", "", "", "(us)");
+  printf("%10s %8zu %8zu %8.1f\n", bench->renderer, state.tranches,
+         state.formats, elapsed / 1000.0);
+
+  if (!state.main_device || state.table_entries == 0 || state.tranches == 0 ||
+      state.formats == 0 || state.invalid_formats > 0) {
+    fprintf(stderr,
+            "%s: unusable default feedback: main device %s, %" PRIu32
+            " table entries, %zu tranches, %zu formats, %zu out of range\n",
+            bench->renderer, state.main_device ? "set" : "missing",
+            state.table_entries, state.tranches, state.formats,
+            state.invalid_formats);
+    goto out;
+  }
+
+  ret = 0;
+
+out:
+  if (feedback != NULL) {
+    zwp_linux_dmabuf_feedback_v1_destroy(feedback);
+  }
+  bench_client_finish(&client);
+  bench_kill_compositor(bench);
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  struct bench bench = {
+      .compositor = NORA_BENCH_COMPOSITOR,
+      .renderer = "pixman",
+  };
+  const char *windows = "10,100,500";
+  uint32_t rate = 60;
+  uint32_t duration = 5;
+  size_t popups = 0;
+  bool dmabuf = false;
+
+  static const struct option long_options[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"compositor", required_argument, NULL, 'c'},
+      {"windows", required_argument, NULL, 'n'},
+      {"rate", required_argument, NULL, 'r'},
+      {"duration", required_argument, NULL, 'd'},
+      {"popups", required_argument, NULL, 'p'},
+      {"dmabuf", required_argument, NULL, 'b'},
+      {0, 0, 0, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "hc:n:r:d:p:b:", long_options, NULL)) !=
+         -1) {
+    switch (c) {
+    case 'c':
+      bench.compositor = optarg;
+      break;
+    case 'n':
+      windows = optarg;
+      break;
+    case 'r':
+      rate = strtoul(optarg, NULL, 10);
+      break;
+    case 'd':
+      duration = strtoul(optarg, NULL, 10);
+      break;
+    case 'p':
+      popups = strtoul(optarg, NULL, 10);
+      break;
+    case 'b':
+      bench.renderer = optarg;
+      dmabuf = true;
+      break;
+    case 'h':
+      printf("%s", usage);
+      return 0;
+    default:
+      fprintf(stderr, "%s", usage);
+      return 1;
+    }
+  }
+
+  if (rate == 0 || duration == 0) {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+
+  // A dying compositor must not take the harness with it.
+  signal(SIGPIPE, SIG_IGN);
+
+  if (dmabuf) {
+    return bench_run_dmabuf(&bench);
+  }
+
+  if (popups > 0) {
+    int ret = bench_run_popups(&bench, popups) ? 0 : 1;
+    free(bench.latencies);
+    return ret;
+  }
+
+  printf("%7s %8s %10s %8s %9s %9s %9s %9s\n", "windows", "frames",
+         "cpu/frame", "cpu", "lat p50", "lat p99", "rss", "rss peak");
+  printf("%7s %8s %10s %8s %9s %9s %9s %9s\n", "", "", "(us)", "(%)", "(ms)",
+         "(ms)", "(MiB)", "(MiB)");
+
+  int ret = 0;
+  char *list = strdup(windows);
+  for (char *save = NULL, *count = strtok_r(list, ",", &save); count != NULL;
+       count = strtok_r(NULL, ",", &save)) {
+    size_t n = strtoul(count, NULL, 10);
+    if (n == 0) {
+      continue;
+    }
+
+    if (!bench_run(&bench, n, rate, duration)) {
+      fprintf(stderr, "run with %zu windows failed\n", n);
+      ret = 1;
+      break;
+    }
+  }
+
+  free(list);
+  free(bench.latencies);
+  return ret;
+}
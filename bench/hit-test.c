@@ -0,0 +1,207 @@
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/box.h>
+
+#include "grid.h"
+
+#define HIT_TEST_OUTPUT_WIDTH 1920
+#define HIT_TEST_OUTPUT_HEIGHT 1080
+
+static const char usage[] =
+    "Usage: nora-bench-hit-test [options]\n"
+    "\n"
+    "Compares resolving the node under the pointer by walking the whole scene\n"
+    "with wlr_scene_node_at against the per-output grid nora hit-tests\n"
+    "through, which only descends into the candidates of one cell.\n"
+    "\n"
+    "  -h, --help               Show this help message.\n"
+    "  -n, --windows <n,...>    Window counts to measure. Default: 10,100,500\n"
+    "  -q, --queries <n>        Hit-tests per window count. Default: 1000000\n";
+
+struct hit_test_window {
+  struct wlr_box box;
+  struct wlr_scene_rect *rect;
+};
+
+static int64_t now_nsec(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Same walk as nora_tree_root_find_container_at, minus the surface lookup.
+static struct wlr_scene_node *grid_node_at(struct nora_grid *grid, double lx,
+                                           double ly) {
+  struct wl_array *cell = nora_grid_cell_at(grid, lx, ly);
+  if (cell == NULL) {
+    return NULL;
+  }
+
+  struct nora_grid_entry *entries = cell->data;
+  for (size_t i = cell->size / sizeof(*entries); i-- > 0;) {
+    struct hit_test_window *window = entries[i].data;
+    if (!wlr_box_contains_point(&window->box, lx, ly)) {
+      continue;
+    }
+
+    double sx, sy;
+    struct wlr_scene_node *node =
+        wlr_scene_node_at(&window->rect->node, lx, ly, &sx, &sy);
+    if (node != NULL) {
+      return node;
+    }
+  }
+
+  return NULL;
+}
+
+static bool hit_test_run(size_t windows, size_t queries) {
+  struct wlr_scene *scene = wlr_scene_create();
+  struct hit_test_window *list = calloc(windows, sizeof(*list));
+  double *points = calloc(queries * 2, sizeof(*points));
+  if (scene == NULL || list == NULL || points == NULL) {
+    fprintf(stderr, "out of memory\n");
+    free(list);
+    free(points);
+    return false;
+  }
+
+  struct nora_grid grid;
+  nora_grid_init(&grid);
+  nora_grid_reset(&grid, &(struct wlr_box){
+                             .width = HIT_TEST_OUTPUT_WIDTH,
+                             .height = HIT_TEST_OUTPUT_HEIGHT,
+                         });
+
+  // Fixed seed, runs are comparable with each other.
+  srand(1);
+
+  const float color[4] = {1, 1, 1, 1};
+  for (size_t i = 0; i < windows; ++i) {
+    struct wlr_box *box = &list[i].box;
+    box->width = 100 + rand() % 700;
+    box->height = 100 + rand() % 500;
+    box->x = rand() % (HIT_TEST_OUTPUT_WIDTH - box->width);
+    box->y = rand() % (HIT_TEST_OUTPUT_HEIGHT - box->height);
+
+    // Later windows are stacked above, in the scene and in the grid.
+    list[i].rect =
+        wlr_scene_rect_create(&scene->tree, box->width, box->height, color);
+    wlr_scene_node_set_position(&list[i].rect->node, box->x, box->y);
+    nora_grid_insert(&grid, box, i, &list[i]);
+  }
+
+  for (size_t i = 0; i < queries; ++i) {
+    points[i * 2] = rand() % HIT_TEST_OUTPUT_WIDTH + 0.5;
+    points[i * 2 + 1] = rand() % HIT_TEST_OUTPUT_HEIGHT + 0.5;
+  }
+
+  size_t scene_hits = 0;
+  int64_t start = now_nsec();
+  for (size_t i = 0; i < queries; ++i) {
+    double sx, sy;
+    scene_hits += wlr_scene_node_at(&scene->tree.node, points[i * 2],
+                                    points[i * 2 + 1], &sx, &sy) != NULL;
+  }
+  int64_t scene_nsec = now_nsec() - start;
+
+  size_t grid_hits = 0;
+  start = now_nsec();
+  for (size_t i = 0; i < queries; ++i) {
+    grid_hits +=
+        grid_node_at(&grid, points[i * 2], points[i * 2 + 1]) != NULL;
+  }
+  int64_t grid_nsec = now_nsec() - start;
+
+  // Both have to find the same nodes, or the comparison is moot.
+  size_t mismatches = 0;
+  for (size_t i = 0; i < queries && i < 10000; ++i) {
+    double sx, sy;
+    mismatches += wlr_scene_node_at(&scene->tree.node, points[i * 2],
+                                    points[i * 2 + 1], &sx, &sy) !=
+                  grid_node_at(&grid, points[i * 2], points[i * 2 + 1]);
+  }
+
+  printf("%7zu %12.1f %12.1f %8.1fx\n", windows,
+         (double)scene_nsec / queries, (double)grid_nsec / queries,
+         grid_nsec > 0 ? (double)scene_nsec / grid_nsec : 0.0);
+  fflush(stdout);
+
+  nora_grid_finish(&grid);
+  wlr_scene_node_destroy(&scene->tree.node);
+  free(list);
+  free(points);
+
+  if (scene_hits != grid_hits || mismatches != 0) {
+    fprintf(stderr, "%zu windows: grid and scene disagree on %zu points\n",
+            windows, mismatches);
+    return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const char *windows = "10,100,500";
+  size_t queries = 1000000;
+
+  static const struct option long_options[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"windows", required_argument, NULL, 'n'},
+      {"queries", required_argument, NULL, 'q'},
+      {0, 0, 0, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "hn:q:", long_options, NULL)) != -1) {
+    switch (c) {
+    case 'n':
+      windows = optarg;
+      break;
+    case 'q':
+      queries = strtoul(optarg, NULL, 10);
+      break;
+    case 'h':
+      printf("%s", usage);
+      return 0;
+    default:
+      fprintf(stderr, "%s", usage);
+      return 1;
+    }
+  }
+
+  if (queries == 0) {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+
+  printf("%7s %12s %12s %9s\n", "windows", "scene", "grid", "speedup");
+  printf("%7s %12s %12s %9s\n", "", "(ns/query)", "(ns/query)", "");
+
+  int ret = 0;
+  char *list = strdup(windows);
+  for (char *save = NULL, *count = strtok_r(list, ",", &save); count != NULL;
+       count = strtok_r(NULL, ",", &save)) {
+    size_t n = strtoul(count, NULL, 10);
+    if (n == 0) {
+      continue;
+    }
+
+    if (!hit_test_run(n, queries)) {
+      ret = 1;
+      break;
+    }
+  }
+
+  free(list);
+  return ret;
+}
@@ -0,0 +1,286 @@
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <inttypes.h>
+#include <linux/input-event-codes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <wayland-util.h>
+#include <xkbcommon/xkbcommon.h>
+
+#include "bindings.h"
+
+static const char usage[] =
+    "Usage: nora-bench-keys [options]\n"
+    "\n"
+    "Fires key events through the same steps as nora's key handler: the xkb\n"
+    "state update, the first-level keysym lookup, nora_bindings_lookup and\n"
+    "the set of held bound keys. Every round holds every default binding at\n"
+    "once, and checks that exactly the unbound presses and releases would\n"
+    "have been forwarded to the client.\n"
+    "\n"
+    "  -h, --help               Show this help message.\n"
+    "  -r, --rounds <n>         Rounds of key events. Default: 200000\n"
+    "  -b, --bindings <n>       Extra bindings added to the default mode.\n"
+    "                           Default: 0\n";
+
+// Pressed in this order with Alt held, every one of them is bound.
+static const uint32_t bound_keys[] = {
+    KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8,
+    KEY_9, KEY_J, KEY_K, KEY_H, KEY_V, KEY_W, KEY_S, KEY_ENTER,
+};
+// Then pressed with Alt and Shift held, bound as well.
+static const uint32_t bound_shift_keys[] = {KEY_E, KEY_P};
+// Then pressed with Alt and Shift still held, none of them is bound.
+static const uint32_t unbound_keys[] = {
+    KEY_A, KEY_B, KEY_C, KEY_D, KEY_F, KEY_G, KEY_Q, KEY_Z,
+};
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+struct bench_held_key {
+  uint32_t keycode;
+  const struct nora_binding *binding;
+};
+
+struct bench_keyboard {
+  struct xkb_keymap *keymap;
+  struct xkb_state *state;
+  struct nora_bindings bindings;
+
+  xkb_mod_index_t shift, ctrl, alt, logo;
+
+  struct wl_array held; // bench_held_key
+
+  uint64_t events;
+  uint64_t forwarded;
+  uint64_t bound;
+};
+
+static int64_t now_nsec(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Like wlr_keyboard_get_modifiers.
+static uint32_t bench_keyboard_modifiers(struct bench_keyboard *keyboard) {
+  uint32_t modifiers = 0;
+  if (xkb_state_mod_index_is_active(keyboard->state, keyboard->shift,
+                                    XKB_STATE_MODS_EFFECTIVE) > 0) {
+    modifiers |= WLR_MODIFIER_SHIFT;
+  }
+  if (xkb_state_mod_index_is_active(keyboard->state, keyboard->ctrl,
+                                    XKB_STATE_MODS_EFFECTIVE) > 0) {
+    modifiers |= WLR_MODIFIER_CTRL;
+  }
+  if (xkb_state_mod_index_is_active(keyboard->state, keyboard->alt,
+                                    XKB_STATE_MODS_EFFECTIVE) > 0) {
+    modifiers |= WLR_MODIFIER_ALT;
+  }
+  if (xkb_state_mod_index_is_active(keyboard->state, keyboard->logo,
+                                    XKB_STATE_MODS_EFFECTIVE) > 0) {
+    modifiers |= WLR_MODIFIER_LOGO;
+  }
+
+  return modifiers;
+}
+
+// Mirrors keyboard_press_binding, minus running the binding.
+static bool bench_press_binding(struct bench_keyboard *keyboard,
+                                uint32_t keycode) {
+  xkb_keycode_t xkb_keycode = keycode + 8;
+  const xkb_keysym_t *syms;
+  int nsyms = xkb_keymap_key_get_syms_by_level(
+      keyboard->keymap, xkb_keycode,
+      xkb_state_key_get_layout(keyboard->state, xkb_keycode), 0, &syms);
+
+  uint32_t modifiers = bench_keyboard_modifiers(keyboard);
+  for (int i = 0; i < nsyms; i++) {
+    const struct nora_binding *binding =
+        nora_bindings_lookup(&keyboard->bindings, modifiers, syms[i]);
+    if (binding == NULL) {
+      continue;
+    }
+
+    struct bench_held_key *held = wl_array_add(&keyboard->held, sizeof(*held));
+    if (held == NULL) {
+      return false;
+    }
+
+    held->keycode = keycode;
+    held->binding = binding;
+    keyboard->bound++;
+    return true;
+  }
+
+  return false;
+}
+
+// Mirrors keyboard_release_binding.
+static bool bench_release_binding(struct bench_keyboard *keyboard,
+                                  uint32_t keycode) {
+  struct bench_held_key *held = keyboard->held.data;
+  size_t count = keyboard->held.size / sizeof(*held);
+  for (size_t i = 0; i < count; ++i) {
+    if (held[i].keycode != keycode) {
+      continue;
+    }
+
+    held[i] = held[count - 1];
+    keyboard->held.size -= sizeof(*held);
+    return true;
+  }
+
+  return false;
+}
+
+static void bench_key(struct bench_keyboard *keyboard, uint32_t keycode,
+                      bool pressed) {
+  keyboard->events++;
+
+  // wlr_keyboard updates the xkb state before emitting the key event.
+  xkb_state_update_key(keyboard->state, keycode + 8,
+                       pressed ? XKB_KEY_DOWN : XKB_KEY_UP);
+
+  bool handled = pressed ? bench_press_binding(keyboard, keycode)
+                         : bench_release_binding(keyboard, keycode);
+  if (!handled) {
+    keyboard->forwarded++;
+  }
+}
+
+static void bench_round(struct bench_keyboard *keyboard) {
+  bench_key(keyboard, KEY_LEFTALT, true);
+  for (size_t i = 0; i < ARRAY_LENGTH(bound_keys); ++i) {
+    bench_key(keyboard, bound_keys[i], true);
+  }
+
+  bench_key(keyboard, KEY_LEFTSHIFT, true);
+  for (size_t i = 0; i < ARRAY_LENGTH(bound_shift_keys); ++i) {
+    bench_key(keyboard, bound_shift_keys[i], true);
+  }
+  for (size_t i = 0; i < ARRAY_LENGTH(unbound_keys); ++i) {
+    bench_key(keyboard, unbound_keys[i], true);
+    bench_key(keyboard, unbound_keys[i], false);
+  }
+
+  for (size_t i = ARRAY_LENGTH(bound_shift_keys); i-- > 0;) {
+    bench_key(keyboard, bound_shift_keys[i], false);
+  }
+  bench_key(keyboard, KEY_LEFTSHIFT, false);
+
+  for (size_t i = ARRAY_LENGTH(bound_keys); i-- > 0;) {
+    bench_key(keyboard, bound_keys[i], false);
+  }
+  bench_key(keyboard, KEY_LEFTALT, false);
+}
+
+int main(int argc, char **argv) {
+  size_t rounds = 200000;
+  size_t extra_bindings = 0;
+
+  static const struct option long_options[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"rounds", required_argument, NULL, 'r'},
+      {"bindings", required_argument, NULL, 'b'},
+      {0, 0, 0, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "hr:b:", long_options, NULL)) != -1) {
+    switch (c) {
+    case 'r':
+      rounds = strtoul(optarg, NULL, 10);
+      break;
+    case 'b':
+      extra_bindings = strtoul(optarg, NULL, 10);
+      break;
+    case 'h':
+      printf("%s", usage);
+      return 0;
+    default:
+      fprintf(stderr, "%s", usage);
+      return 1;
+    }
+  }
+
+  if (rounds == 0) {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+
+  struct bench_keyboard keyboard = {0};
+  struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+  struct xkb_rule_names names = {0};
+  keyboard.keymap = xkb_keymap_new_from_names(context, &names,
+                                              XKB_KEYMAP_COMPILE_NO_FLAGS);
+  if (keyboard.keymap == NULL) {
+    fprintf(stderr, "failed to compile the default keymap\n");
+    xkb_context_unref(context);
+    return 1;
+  }
+
+  keyboard.state = xkb_state_new(keyboard.keymap);
+  keyboard.shift =
+      xkb_keymap_mod_get_index(keyboard.keymap, XKB_MOD_NAME_SHIFT);
+  keyboard.ctrl = xkb_keymap_mod_get_index(keyboard.keymap, XKB_MOD_NAME_CTRL);
+  keyboard.alt = xkb_keymap_mod_get_index(keyboard.keymap, XKB_MOD_NAME_ALT);
+  keyboard.logo = xkb_keymap_mod_get_index(keyboard.keymap, XKB_MOD_NAME_LOGO);
+  wl_array_init(&keyboard.held);
+
+  nora_bindings_init(&keyboard.bindings);
+  nora_bindings_add_defaults(&keyboard.bindings);
+  // Never pressed, they only fill the table.
+  for (size_t i = 0; i < extra_bindings; ++i) {
+    nora_bindings_add(&keyboard.bindings, 0,
+                      (struct nora_binding){
+                          .modifiers = WLR_MODIFIER_LOGO,
+                          .keysym = XKB_KEY_XF86ModeLock + i,
+                          .action = NORA_BINDING_ACTION_SPAWN,
+                          .arg.command = "true",
+                      });
+  }
+  nora_bindings_compile(&keyboard.bindings);
+
+  // Warm up, so that the held set reached its final capacity.
+  bench_round(&keyboard);
+  keyboard.events = keyboard.forwarded = keyboard.bound = 0;
+
+  int64_t start = now_nsec();
+  for (size_t i = 0; i < rounds; ++i) {
+    bench_round(&keyboard);
+  }
+  int64_t elapsed = now_nsec() - start;
+
+  printf("%10s %10s %10s %12s %10s\n", "events", "bound", "forwarded",
+         "events/s", "per event");
+  printf("%10s %10s %10s %12s %10s\n", "", "", "", "", "(ns)");
+  printf("%10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %12.0f %10.1f\n",
+         keyboard.events, keyboard.bound, keyboard.forwarded,
+         keyboard.events * 1e9 / elapsed, (double)elapsed / keyboard.events);
+
+  // Alt and Shift, plus every unbound key, each pressed and released.
+  uint64_t expected_forwarded = rounds * (2 + ARRAY_LENGTH(unbound_keys)) * 2;
+  uint64_t expected_bound =
+      rounds * (ARRAY_LENGTH(bound_keys) + ARRAY_LENGTH(bound_shift_keys));
+  int ret = 0;
+  if (keyboard.forwarded != expected_forwarded ||
+      keyboard.bound != expected_bound || keyboard.held.size != 0) {
+    fprintf(stderr,
+            "expected %" PRIu64 " bound and %" PRIu64 " forwarded events\n",
+            expected_bound, expected_forwarded);
+    ret = 1;
+  }
+
+  nora_bindings_finish(&keyboard.bindings);
+  wl_array_release(&keyboard.held);
+  xkb_state_unref(keyboard.state);
+  xkb_keymap_unref(keyboard.keymap);
+  xkb_context_unref(context);
+  return ret;
+}
@@ -0,0 +1,209 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <wlr/util/log.h>
+
+#include "bindings.h"
+#include "layout.h"
+
+static uint32_t nora_binding_hash(uint32_t modifiers, xkb_keysym_t keysym) {
+  uint32_t hash = keysym * 2654435761u;
+  hash ^= modifiers * 0x9e3779b9u;
+  return hash ^ (hash >> 16);
+}
+
+void nora_bindings_init(struct nora_bindings *bindings) {
+  memset(bindings, 0, sizeof(*bindings));
+  nora_bindings_mode(bindings, "default");
+}
+
+void nora_bindings_finish(struct nora_bindings *bindings) {
+  for (size_t i = 0; i < bindings->mode_count; ++i) {
+    struct nora_binding_mode *mode = &bindings->modes[i];
+    wl_array_release(&mode->bindings);
+    free(mode->table);
+    mode->table = NULL;
+  }
+
+  bindings->mode_count = 0;
+}
+
+uint32_t nora_bindings_mode(struct nora_bindings *bindings, const char *name) {
+  for (size_t i = 0; i < bindings->mode_count; ++i) {
+    if (strcmp(bindings->modes[i].name, name) == 0) {
+      return i;
+    }
+  }
+
+  assert(bindings->mode_count < NORA_BINDING_MODES_MAX);
+
+  struct nora_binding_mode *mode = &bindings->modes[bindings->mode_count];
+  mode->name = name;
+  wl_array_init(&mode->bindings);
+
+  return bindings->mode_count++;
+}
+
+void nora_bindings_add(struct nora_bindings *bindings, uint32_t mode,
+                       struct nora_binding binding) {
+  assert(mode < bindings->mode_count);
+
+  binding.modifiers &= NORA_BINDING_MODIFIER_MASK;
+  binding.keysym = xkb_keysym_to_lower(binding.keysym);
+
+  struct nora_binding *slot =
+      wl_array_add(&bindings->modes[mode].bindings, sizeof(*slot));
+  if (slot == NULL) {
+    wlr_log(WLR_ERROR, "failed to allocate binding");
+    return;
+  }
+
+  *slot = binding;
+}
+
+static void nora_binding_mode_compile(struct nora_binding_mode *mode) {
+  size_t count = mode->bindings.size / sizeof(struct nora_binding);
+
+  // Keep the load factor at or below one half so probes stay short.
+  size_t size = 8;
+  while (size < count * 2) {
+    size *= 2;
+  }
+
+  free(mode->table);
+  mode->table = calloc(size, sizeof(*mode->table));
+  mode->table_mask = size - 1;
+
+  struct nora_binding *binding;
+  wl_array_for_each(binding, &mode->bindings) {
+    size_t i =
+        nora_binding_hash(binding->modifiers, binding->keysym) & mode->table_mask;
+    while (mode->table[i].keysym != XKB_KEY_NoSymbol) {
+      if (mode->table[i].modifiers == binding->modifiers &&
+          mode->table[i].keysym == binding->keysym) {
+        wlr_log(WLR_INFO, "binding for keysym %#x in mode %s overridden",
+                binding->keysym, mode->name);
+        break;
+      }
+
+      i = (i + 1) & mode->table_mask;
+    }
+
+    mode->table[i] = *binding;
+  }
+}
+
+void nora_bindings_compile(struct nora_bindings *bindings) {
+  for (size_t i = 0; i < bindings->mode_count; ++i) {
+    nora_binding_mode_compile(&bindings->modes[i]);
+  }
+}
+
+const struct nora_binding *
+nora_bindings_lookup(const struct nora_bindings *bindings, uint32_t modifiers,
+                     xkb_keysym_t keysym) {
+  const struct nora_binding_mode *mode =
+      &bindings->modes[bindings->current_mode];
+  if (mode->table == NULL) {
+    return NULL;
+  }
+
+  modifiers &= NORA_BINDING_MODIFIER_MASK;
+  keysym = xkb_keysym_to_lower(keysym);
+
+  size_t i = nora_binding_hash(modifiers, keysym) & mode->table_mask;
+  while (mode->table[i].keysym != XKB_KEY_NoSymbol) {
+    if (mode->table[i].modifiers == modifiers &&
+        mode->table[i].keysym == keysym) {
+      return &mode->table[i];
+    }
+
+    i = (i + 1) & mode->table_mask;
+  }
+
+  return NULL;
+}
+
+void nora_bindings_add_defaults(struct nora_bindings *bindings) {
+  uint32_t normal = nora_bindings_mode(bindings, "default");
+  uint32_t passthrough = nora_bindings_mode(bindings, "passthrough");
+
+  nora_bindings_add(bindings, normal,
+                    (struct nora_binding){
+                        .modifiers = WLR_MODIFIER_ALT,
+                        .keysym = XKB_KEY_Return,
+                        .action = NORA_BINDING_ACTION_SPAWN,
+                        .arg.command = "${TERMINAL:-foot}",
+                    });
+
+  for (uint32_t i = 0; i < 9; ++i) {
+    nora_bindings_add(bindings, normal,
+                      (struct nora_binding){
+                          .modifiers = WLR_MODIFIER_ALT,
+                          .keysym = XKB_KEY_1 + i,
+                          .action = NORA_BINDING_ACTION_WORKSPACE,
+                          .arg.workspace = i,
+                      });
+  }
+
+  nora_bindings_add(bindings, normal,
+                    (struct nora_binding){
+                        .modifiers = WLR_MODIFIER_ALT,
+                        .keysym = XKB_KEY_j,
+                        .flags = NORA_BINDING_REPEAT,
+                        .action = NORA_BINDING_ACTION_FOCUS_NEXT,
+                    });
+  nora_bindings_add(bindings, normal,
+                    (struct nora_binding){
+                        .modifiers = WLR_MODIFIER_ALT,
+                        .keysym = XKB_KEY_k,
+                        .flags = NORA_BINDING_REPEAT,
+                        .action = NORA_BINDING_ACTION_FOCUS_PREVIOUS,
+                    });
+
+  // Layout of the container the focused view is tiled in.
+  static const struct {
+    xkb_keysym_t keysym;
+    enum nora_layout_kind layout;
+  } layouts[] = {
+      {XKB_KEY_h, NORA_LAYOUT_SPLIT_HORIZONTAL},
+      {XKB_KEY_v, NORA_LAYOUT_SPLIT_VERTICAL},
+      {XKB_KEY_w, NORA_LAYOUT_TABBED},
+      {XKB_KEY_s, NORA_LAYOUT_STACKED},
+  };
+  for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); ++i) {
+    nora_bindings_add(bindings, normal,
+                      (struct nora_binding){
+                          .modifiers = WLR_MODIFIER_ALT,
+                          .keysym = layouts[i].keysym,
+                          .action = NORA_BINDING_ACTION_LAYOUT,
+                          .arg.layout = layouts[i].layout,
+                      });
+  }
+
+  nora_bindings_add(bindings, normal,
+                    (struct nora_binding){
+                        .modifiers = WLR_MODIFIER_ALT | WLR_MODIFIER_SHIFT,
+                        .keysym = XKB_KEY_e,
+                        .flags = NORA_BINDING_RELEASE,
+                        .action = NORA_BINDING_ACTION_QUIT,
+                    });
+
+  // Passthrough sends every key but its own toggle to clients, e.g. for
+  // nested compositors and virtual machines.
+  nora_bindings_add(bindings, normal,
+                    (struct nora_binding){
+                        .modifiers = WLR_MODIFIER_ALT | WLR_MODIFIER_SHIFT,
+                        .keysym = XKB_KEY_p,
+                        .action = NORA_BINDING_ACTION_MODE,
+                        .arg.mode = passthrough,
+                    });
+  nora_bindings_add(bindings, passthrough,
+                    (struct nora_binding){
+                        .modifiers = WLR_MODIFIER_ALT | WLR_MODIFIER_SHIFT,
+                        .keysym = XKB_KEY_p,
+                        .action = NORA_BINDING_ACTION_MODE,
+                        .arg.mode = normal,
+                    });
+}
@@ -0,0 +1,84 @@
+#ifndef NORA_BINDINGS_H_
+#define NORA_BINDINGS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <wayland-util.h>
+#include <wlr/types/wlr_keyboard.h>
+#include <xkbcommon/xkbcommon.h>
+
+#define NORA_BINDING_MODES_MAX 8
+
+// Lock modifiers (caps lock, num lock) never take part in matching.
+#define NORA_BINDING_MODIFIER_MASK                                             \
+  (WLR_MODIFIER_SHIFT | WLR_MODIFIER_CTRL | WLR_MODIFIER_ALT |                 \
+   WLR_MODIFIER_MOD3 | WLR_MODIFIER_LOGO | WLR_MODIFIER_MOD5)
+
+enum nora_binding_flags {
+  // Run the binding when the key is released instead of pressed.
+  NORA_BINDING_RELEASE = 1 << 0,
+  // Keep running the binding at the keyboard repeat rate while held.
+  NORA_BINDING_REPEAT = 1 << 1,
+};
+
+enum nora_binding_action {
+  NORA_BINDING_ACTION_SPAWN,
+  NORA_BINDING_ACTION_WORKSPACE,
+  NORA_BINDING_ACTION_FOCUS_NEXT,
+  NORA_BINDING_ACTION_FOCUS_PREVIOUS,
+  NORA_BINDING_ACTION_MODE,
+  NORA_BINDING_ACTION_LAYOUT,
+  NORA_BINDING_ACTION_QUIT,
+};
+
+struct nora_binding {
+  uint32_t modifiers;
+  xkb_keysym_t keysym; // XKB_KEY_NoSymbol marks an empty slot
+  uint32_t flags;
+
+  enum nora_binding_action action;
+  union {
+    const char *command;
+    uint32_t workspace;
+    uint32_t mode;
+    uint32_t layout; // nora_layout_kind
+  } arg;
+};
+
+struct nora_binding_mode {
+  const char *name;
+
+  struct wl_array bindings; // nora_binding, as configured
+
+  // Open addressing hash table keyed on (modifiers, keysym), built by
+  // nora_bindings_compile. Its size is a power of two.
+  struct nora_binding *table;
+  size_t table_mask;
+};
+
+struct nora_bindings {
+  struct nora_binding_mode modes[NORA_BINDING_MODES_MAX];
+  size_t mode_count;
+  size_t current_mode;
+};
+
+void nora_bindings_init(struct nora_bindings *bindings);
+void nora_bindings_finish(struct nora_bindings *bindings);
+
+// Returns the index of the mode, creating it if needed.
+uint32_t nora_bindings_mode(struct nora_bindings *bindings, const char *name);
+void nora_bindings_add(struct nora_bindings *bindings, uint32_t mode,
+                       struct nora_binding binding);
+// Builds the lookup tables, must be called after bindings were added.
+void nora_bindings_compile(struct nora_bindings *bindings);
+
+// Looks up a binding in the current mode. Never allocates.
+const struct nora_binding *
+nora_bindings_lookup(const struct nora_bindings *bindings, uint32_t modifiers,
+                     xkb_keysym_t keysym);
+
+void nora_bindings_add_defaults(struct nora_bindings *bindings);
+
+#endif // NORA_BINDINGS_H_
@@ -1,3 +1,4 @@
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wayland-server-core.h>
@@ -13,31 +14,14 @@ nora_desktop_manager_resource_destroy(struct wl_resource *resource) {
   wl_list_remove(wl_resource_get_link(resource));
 }
 
-static void nora_desktop_manager_bind(struct wl_client *client, void *data,
-                                      uint32_t version, uint32_t id) {
-  struct nora_desktop_manager_unstable_v1 *manager = data;
-
-  struct wl_resource *resource = wl_resource_create(
-      client, &nora_desktop_manager_v1_interface, version, id);
-  if (!resource) {
-    wl_client_post_no_memory(client);
+static void on_view_hide(struct wl_client *client, struct wl_resource *resource) {
+  struct nora_desktop_view_handle_unstable_v1 *view_handle =
+      wl_resource_get_user_data(resource);
+  if (view_handle == NULL) {
     return;
   }
 
-  wlr_log(WLR_INFO, "Got client!");
-
-  wl_resource_set_implementation(resource, NULL, manager,
-                                 nora_desktop_manager_resource_destroy);
-
-  wl_list_insert(&manager->resources, wl_resource_get_link(resource));
-
-  // TODO: Report all know toplevels and workspaces here.
-
-  return;
-}
-
-static void on_view_hide(struct wl_client *client, struct wl_resource *resource) {
-  wlr_log(WLR_INFO, "received hide request");
+  wl_signal_emit_mutable(&view_handle->events.request_hide, view_handle);
 }
 
 static const struct nora_desktop_view_v1_interface view_interface = {
@@ -70,6 +54,159 @@ static struct wl_resource *create_view_handle_resource_for_resource(
   return resource;
 }
 
+static void
+nora_desktop_workspace_handle_resource_destroy(struct wl_resource *resource) {
+  wl_list_remove(wl_resource_get_link(resource));
+}
+
+static struct wl_resource *create_workspace_handle_resource_for_resource(
+    struct nora_desktop_workspace_handle_unstable_v1 *workspace_handle,
+    struct wl_resource *manager_resource) {
+  struct wl_client *client = wl_resource_get_client(manager_resource);
+  struct wl_resource *resource =
+      wl_resource_create(client, &nora_desktop_workspace_v1_interface,
+                         wl_resource_get_version(manager_resource), 0);
+  if (!resource) {
+    wl_client_post_no_memory(client);
+    return NULL;
+  }
+
+  wl_resource_set_implementation(
+      resource, NULL, workspace_handle,
+      nora_desktop_workspace_handle_resource_destroy);
+
+  wl_list_insert(&workspace_handle->resources, wl_resource_get_link(resource));
+  nora_desktop_manager_v1_send_workspace(manager_resource, resource);
+  if (workspace_handle->id != NULL) {
+    nora_desktop_workspace_v1_send_id(resource, workspace_handle->id);
+  }
+
+  return resource;
+}
+
+static void view_handle_send_state(
+    struct nora_desktop_view_handle_unstable_v1 *view_handle,
+    struct wl_resource *resource) {
+  if (view_handle->app_id != NULL) {
+    nora_desktop_view_v1_send_app_id(resource, view_handle->app_id);
+  }
+  if (view_handle->title != NULL) {
+    nora_desktop_view_v1_send_title(resource, view_handle->title);
+  }
+  nora_desktop_view_v1_send_hidden(resource, view_handle->hidden);
+}
+
+static void view_handle_send_done(struct wl_resource *resource) {
+  if (wl_resource_get_version(resource) >=
+      NORA_DESKTOP_VIEW_V1_DONE_SINCE_VERSION) {
+    nora_desktop_view_v1_send_done(resource);
+  }
+}
+
+enum nora_desktop_view_attribute {
+  NORA_DESKTOP_VIEW_TITLE = 1 << 0,
+  NORA_DESKTOP_VIEW_APP_ID = 1 << 1,
+};
+
+// Sends the attributes queued for the next flush right away.
+static void view_handle_send_updates(
+    struct nora_desktop_view_handle_unstable_v1 *view_handle) {
+  struct wl_resource *resource;
+  wl_resource_for_each(resource, &view_handle->resources) {
+    if (view_handle->dirty & NORA_DESKTOP_VIEW_TITLE) {
+      nora_desktop_view_v1_send_title(
+          resource, view_handle->title ? view_handle->title : "");
+    }
+    if (view_handle->dirty & NORA_DESKTOP_VIEW_APP_ID) {
+      nora_desktop_view_v1_send_app_id(
+          resource, view_handle->app_id ? view_handle->app_id : "");
+    }
+  }
+
+  view_handle->dirty = 0;
+}
+
+static void handle_done_idle(void *data) {
+  struct nora_desktop_manager_unstable_v1 *manager = data;
+  manager->done_idle = NULL;
+
+  struct nora_desktop_view_handle_unstable_v1 *view_handle;
+  wl_list_for_each(view_handle, &manager->views, link) {
+    if (!view_handle->done_pending) {
+      continue;
+    }
+
+    view_handle->done_pending = false;
+
+    /* The title and app_id a client sets right after creating its toplevel
+     * belong to the initial state, they do not wait for the next flush. */
+    if (!view_handle->announced) {
+      view_handle->announced = true;
+      view_handle_send_updates(view_handle);
+    }
+
+    struct wl_resource *resource;
+    wl_resource_for_each(resource, &view_handle->resources) {
+      view_handle_send_done(resource);
+    }
+  }
+}
+
+// Attribute events sent during one dispatch share a single done event, sent
+// once the event loop goes idle.
+static void view_handle_schedule_done(
+    struct nora_desktop_view_handle_unstable_v1 *view_handle) {
+  struct nora_desktop_manager_unstable_v1 *manager = view_handle->manager;
+
+  view_handle->done_pending = true;
+  if (manager->done_idle == NULL) {
+    manager->done_idle =
+        wl_event_loop_add_idle(manager->event_loop, handle_done_idle, manager);
+  }
+}
+
+static void nora_desktop_manager_bind(struct wl_client *client, void *data,
+                                      uint32_t version, uint32_t id) {
+  struct nora_desktop_manager_unstable_v1 *manager = data;
+
+  struct wl_resource *resource = wl_resource_create(
+      client, &nora_desktop_manager_v1_interface, version, id);
+  if (!resource) {
+    wl_client_post_no_memory(client);
+    return;
+  }
+
+  wlr_log(WLR_INFO, "Got client!");
+
+  wl_resource_set_implementation(resource, NULL, manager,
+                                 nora_desktop_manager_resource_destroy);
+
+  wl_list_insert(&manager->resources, wl_resource_get_link(resource));
+
+  /* Send a snapshot of the desktop, so the client starts out with the whole
+   * of it rather than only what changes from now on. */
+  struct nora_desktop_workspace_handle_unstable_v1 *workspace_handle;
+  wl_list_for_each_reverse(workspace_handle, &manager->workspaces, link) {
+    create_workspace_handle_resource_for_resource(workspace_handle, resource);
+  }
+
+  struct nora_desktop_view_handle_unstable_v1 *view_handle;
+  wl_list_for_each_reverse(view_handle, &manager->views, link) {
+    struct wl_resource *view_resource =
+        create_view_handle_resource_for_resource(view_handle, resource);
+    if (view_resource == NULL) {
+      continue;
+    }
+
+    view_handle_send_state(view_handle, view_resource);
+    view_handle_send_done(view_resource);
+  }
+
+  if (version >= NORA_DESKTOP_MANAGER_V1_DONE_SINCE_VERSION) {
+    nora_desktop_manager_v1_send_done(resource);
+  }
+}
+
 struct nora_desktop_manager_unstable_v1 *
 nora_desktop_manager_unstable_v1_create(struct wl_display *display) {
   struct nora_desktop_manager_unstable_v1 *manager =
@@ -78,9 +215,11 @@ nora_desktop_manager_unstable_v1_create(struct wl_display *display) {
   wl_list_init(&manager->resources);
   wl_list_init(&manager->views);
   wl_list_init(&manager->workspaces);
+  wl_signal_init(&manager->events.update_pending);
 
+  manager->event_loop = wl_display_get_event_loop(display);
   manager->global =
-      wl_global_create(display, &nora_desktop_manager_v1_interface, 1, manager,
+      wl_global_create(display, &nora_desktop_manager_v1_interface, 2, manager,
                        nora_desktop_manager_bind);
 
   return manager;
@@ -93,6 +232,7 @@ nora_desktop_view_unstable_v1_create(
       calloc(1, sizeof(*view_handle));
 
   wl_list_init(&view_handle->resources);
+  wl_signal_init(&view_handle->events.request_hide);
 
   wl_list_insert(&manager->views, &view_handle->link);
   view_handle->manager = manager;
@@ -102,35 +242,94 @@ nora_desktop_view_unstable_v1_create(
     create_view_handle_resource_for_resource(view_handle, manager_resource);
   }
 
+  // The first attributes are set right after creation.
+  view_handle_schedule_done(view_handle);
+
   return view_handle;
 }
 
+static bool string_equal(const char *a, const char *b) {
+  return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+static void view_handle_queue_update(
+    struct nora_desktop_view_handle_unstable_v1 *view_handle,
+    uint32_t attribute) {
+  struct nora_desktop_manager_unstable_v1 *manager = view_handle->manager;
+
+  // The value queued before is replaced without ever being sent.
+  if (view_handle->dirty & attribute) {
+    manager->stats.suppressed_updates++;
+  }
+  view_handle->dirty |= attribute;
+
+  if (!manager->update_pending) {
+    manager->update_pending = true;
+    wl_signal_emit_mutable(&manager->events.update_pending, manager);
+  }
+}
+
+void nora_desktop_manager_unstable_v1_flush(
+    struct nora_desktop_manager_unstable_v1 *manager) {
+  if (!manager->update_pending) {
+    return;
+  }
+
+  manager->update_pending = false;
+
+  struct nora_desktop_view_handle_unstable_v1 *view_handle;
+  wl_list_for_each(view_handle, &manager->views, link) {
+    if (view_handle->dirty == 0) {
+      continue;
+    }
+
+    view_handle_send_updates(view_handle);
+    view_handle_schedule_done(view_handle);
+  }
+}
+
 void nora_desktop_view_handle_unstable_v1_set_title(
-    struct nora_desktop_view_handle_unstable_v1 *view_handle, char *title) {
-  if (view_handle->title) {
-    free(view_handle->title);
+    struct nora_desktop_view_handle_unstable_v1 *view_handle,
+    const char *title) {
+  if (string_equal(view_handle->title, title)) {
+    view_handle->manager->stats.suppressed_updates++;
+    return;
   }
 
-  view_handle->title = strdup(title);
+  free(view_handle->title);
+  view_handle->title = title != NULL ? strdup(title) : NULL;
 
-  struct wl_resource *resource, *tmp;
-  wl_list_for_each_safe(resource, tmp, &view_handle->resources, link) {
-    nora_desktop_view_v1_send_title(resource, view_handle->title);
-  };
+  view_handle_queue_update(view_handle, NORA_DESKTOP_VIEW_TITLE);
 }
 
 void nora_desktop_view_handle_unstable_v1_set_app_id(
-    struct nora_desktop_view_handle_unstable_v1 *view_handle, char *app_id) {
-  if (view_handle->app_id) {
-    free(view_handle->app_id);
+    struct nora_desktop_view_handle_unstable_v1 *view_handle,
+    const char *app_id) {
+  if (string_equal(view_handle->app_id, app_id)) {
+    view_handle->manager->stats.suppressed_updates++;
+    return;
+  }
+
+  free(view_handle->app_id);
+  view_handle->app_id = app_id != NULL ? strdup(app_id) : NULL;
+
+  view_handle_queue_update(view_handle, NORA_DESKTOP_VIEW_APP_ID);
+}
+
+void nora_desktop_view_handle_unstable_v1_set_hidden(
+    struct nora_desktop_view_handle_unstable_v1 *view_handle, bool hidden) {
+  if (view_handle->hidden == hidden) {
+    return;
   }
 
-  view_handle->app_id = strdup(app_id);
+  view_handle->hidden = hidden;
 
   struct wl_resource *resource, *tmp;
   wl_list_for_each_safe(resource, tmp, &view_handle->resources, link) {
-    nora_desktop_view_v1_send_app_id(resource, view_handle->app_id);
+    nora_desktop_view_v1_send_hidden(resource, hidden);
   };
+
+  view_handle_schedule_done(view_handle);
 }
 
 void nora_desktop_view_handle_unstable_v1_destroy(
@@ -142,7 +341,14 @@ void nora_desktop_view_handle_unstable_v1_destroy(
   struct wl_resource *resource, *tmp;
   wl_list_for_each_safe(resource, tmp, &view_handle->resources, link) {
     nora_desktop_view_v1_send_destroy(resource);
+
+    // Requests still in flight must not reach the freed handle.
+    wl_resource_set_user_data(resource, NULL);
+    wl_list_remove(wl_resource_get_link(resource));
+    wl_list_init(wl_resource_get_link(resource));
   };
 
+  free(view_handle->app_id);
+  free(view_handle->title);
   free(view_handle);
 }
@@ -1,6 +1,7 @@
 #ifndef NORA_DESKTOP_MANAGER_H_
 #define NORA_DESKTOP_MANAGER_H_
 
+#include <stdbool.h>
 #include <wayland-server-core.h>
 #include <wayland-util.h>
 
@@ -8,12 +9,27 @@ struct nora_desktop_manager_unstable_v1 {
   struct wl_global *global;
   struct wl_list resources;
 
+  // Sends the done events of every view changed during this dispatch.
+  struct wl_event_loop *event_loop;
+  struct wl_event_source *done_idle;
+
   struct wl_list workspaces;
   struct wl_list views;
 
   struct wl_listener display_destroy;
 
+  // Title and app_id changes wait for nora_desktop_manager_unstable_v1_flush.
+  bool update_pending;
+
+  struct {
+    // Title and app_id changes went unsent, because they did not change the
+    // value or were replaced before the next flush.
+    uint64_t suppressed_updates;
+  } stats;
+
   struct {
+    // Emitted once per flush cycle, when the first change is queued.
+    struct wl_signal update_pending;
   } events;
 
   void *data;
@@ -42,7 +58,16 @@ struct nora_desktop_view_handle_unstable_v1 {
   char *title;
   bool hidden;
 
+  // Attributes were sent since the last done event.
+  bool done_pending;
+  // The first done event was sent, queued attributes are sent along with it
+  // until then.
+  bool announced;
+  // Attributes waiting for the next flush, enum nora_desktop_view_attribute.
+  uint32_t dirty;
+
   struct {
+    struct wl_signal request_hide;
   } events;
 
   void *data;
@@ -55,11 +80,22 @@ struct nora_desktop_view_handle_unstable_v1 *
 nora_desktop_view_unstable_v1_create(
     struct nora_desktop_manager_unstable_v1 *manager);
 
+// Broadcasts the queued title and app_id changes, meant to be called once per
+// output frame.
+void nora_desktop_manager_unstable_v1_flush(
+    struct nora_desktop_manager_unstable_v1 *manager);
+
+// Title and app_id changes are deduplicated and queued until the next flush.
 void nora_desktop_view_handle_unstable_v1_set_title(
-    struct nora_desktop_view_handle_unstable_v1 *view_handle, char *title);
+    struct nora_desktop_view_handle_unstable_v1 *view_handle,
+    const char *title);
 
 void nora_desktop_view_handle_unstable_v1_set_app_id(
-    struct nora_desktop_view_handle_unstable_v1 *view_handle, char *app_id);
+    struct nora_desktop_view_handle_unstable_v1 *view_handle,
+    const char *app_id);
+
+void nora_desktop_view_handle_unstable_v1_set_hidden(
+    struct nora_desktop_view_handle_unstable_v1 *view_handle, bool hidden);
 
 void nora_desktop_view_handle_unstable_v1_destroy(
     struct nora_desktop_view_handle_unstable_v1 *view_handle);
@@ -0,0 +1,128 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "grid.h"
+
+void nora_grid_init(struct nora_grid *grid) {
+  grid->box = (struct wlr_box){0};
+  for (size_t i = 0; i < NORA_GRID_COLUMNS * NORA_GRID_ROWS; ++i) {
+    wl_array_init(&grid->cells[i]);
+  }
+}
+
+void nora_grid_finish(struct nora_grid *grid) {
+  for (size_t i = 0; i < NORA_GRID_COLUMNS * NORA_GRID_ROWS; ++i) {
+    wl_array_release(&grid->cells[i]);
+  }
+}
+
+void nora_grid_reset(struct nora_grid *grid, const struct wlr_box *box) {
+  grid->box = *box;
+  for (size_t i = 0; i < NORA_GRID_COLUMNS * NORA_GRID_ROWS; ++i) {
+    // Keep the allocations around, the cells are refilled right away.
+    grid->cells[i].size = 0;
+  }
+}
+
+static bool nora_grid_cell_range(struct nora_grid *grid,
+                                 const struct wlr_box *box, int *col0,
+                                 int *row0, int *col1, int *row1) {
+  struct wlr_box clipped;
+  if (wlr_box_empty(&grid->box) ||
+      !wlr_box_intersection(&clipped, &grid->box, box)) {
+    return false;
+  }
+
+  int x = clipped.x - grid->box.x;
+  int y = clipped.y - grid->box.y;
+
+  *col0 = x * NORA_GRID_COLUMNS / grid->box.width;
+  *row0 = y * NORA_GRID_ROWS / grid->box.height;
+  *col1 = (x + clipped.width - 1) * NORA_GRID_COLUMNS / grid->box.width;
+  *row1 = (y + clipped.height - 1) * NORA_GRID_ROWS / grid->box.height;
+
+  return true;
+}
+
+static void nora_grid_cell_insert(struct wl_array *cell, uint64_t z,
+                                  void *data) {
+  struct nora_grid_entry *slot = wl_array_add(cell, sizeof(*slot));
+  if (slot == NULL) {
+    return;
+  }
+
+  struct nora_grid_entry *entries = cell->data;
+  size_t count = cell->size / sizeof(*entries);
+
+  // Entries with an equal z keep their insertion order.
+  size_t i = count - 1;
+  while (i > 0 && entries[i - 1].z > z) {
+    --i;
+  }
+
+  memmove(&entries[i + 1], &entries[i], (count - 1 - i) * sizeof(*entries));
+  entries[i] = (struct nora_grid_entry){.z = z, .data = data};
+}
+
+static void nora_grid_cell_remove(struct wl_array *cell, void *data) {
+  struct nora_grid_entry *entries = cell->data;
+  size_t count = cell->size / sizeof(*entries);
+
+  for (size_t i = 0; i < count; ++i) {
+    if (entries[i].data != data) {
+      continue;
+    }
+
+    memmove(&entries[i], &entries[i + 1], (count - 1 - i) * sizeof(*entries));
+    cell->size -= sizeof(*entries);
+    return;
+  }
+}
+
+void nora_grid_insert(struct nora_grid *grid, const struct wlr_box *box,
+                      uint64_t z, void *data) {
+  int col0, row0, col1, row1;
+  if (!nora_grid_cell_range(grid, box, &col0, &row0, &col1, &row1)) {
+    return;
+  }
+
+  for (int row = row0; row <= row1; ++row) {
+    for (int col = col0; col <= col1; ++col) {
+      nora_grid_cell_insert(&grid->cells[row * NORA_GRID_COLUMNS + col], z,
+                            data);
+    }
+  }
+}
+
+void nora_grid_remove(struct nora_grid *grid, const struct wlr_box *box,
+                      void *data) {
+  int col0, row0, col1, row1;
+  if (!nora_grid_cell_range(grid, box, &col0, &row0, &col1, &row1)) {
+    return;
+  }
+
+  for (int row = row0; row <= row1; ++row) {
+    for (int col = col0; col <= col1; ++col) {
+      nora_grid_cell_remove(&grid->cells[row * NORA_GRID_COLUMNS + col], data);
+    }
+  }
+}
+
+struct wl_array *nora_grid_cell_at(struct nora_grid *grid, double lx,
+                                   double ly) {
+  if (!wlr_box_contains_point(&grid->box, lx, ly)) {
+    return NULL;
+  }
+
+  int col = (int)((lx - grid->box.x) * NORA_GRID_COLUMNS / grid->box.width);
+  int row = (int)((ly - grid->box.y) * NORA_GRID_ROWS / grid->box.height);
+
+  if (col >= NORA_GRID_COLUMNS) {
+    col = NORA_GRID_COLUMNS - 1;
+  }
+  if (row >= NORA_GRID_ROWS) {
+    row = NORA_GRID_ROWS - 1;
+  }
+
+  return &grid->cells[row * NORA_GRID_COLUMNS + col];
+}
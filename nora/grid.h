@@ -0,0 +1,41 @@
+#ifndef NORA_GRID_H_
+#define NORA_GRID_H_
+
+#include <stdint.h>
+
+#include <wayland-util.h>
+#include <wlr/util/box.h>
+
+#define NORA_GRID_COLUMNS 8
+#define NORA_GRID_ROWS 8
+
+struct nora_grid_entry {
+  uint64_t z;
+  void *data;
+};
+
+// A uniform grid laid over an output's layout box. Every cell holds the
+// entries whose box intersects it, sorted by ascending z, so a hit-test only
+// has to look at the handful of entries in one cell.
+struct nora_grid {
+  struct wlr_box box;
+  struct wl_array cells[NORA_GRID_COLUMNS * NORA_GRID_ROWS]; // nora_grid_entry
+};
+
+void nora_grid_init(struct nora_grid *grid);
+void nora_grid_finish(struct nora_grid *grid);
+
+// Drops every entry and lays the grid over the given box.
+void nora_grid_reset(struct nora_grid *grid, const struct wlr_box *box);
+
+void nora_grid_insert(struct nora_grid *grid, const struct wlr_box *box,
+                      uint64_t z, void *data);
+void nora_grid_remove(struct nora_grid *grid, const struct wlr_box *box,
+                      void *data);
+
+// Returns the cell covering the layout coordinates or NULL if they fall
+// outside of the grid.
+struct wl_array *nora_grid_cell_at(struct nora_grid *grid, double lx,
+                                   double ly);
+
+#endif // NORA_GRID_H_
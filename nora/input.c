@@ -1,6 +1,14 @@
+#include <errno.h>
 #include <stdbool.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include "input.h"
+#include "layout.h"
+#include "output.h"
 #include "server.h"
+#include "trace.h"
 #include "view.h"
 
 #include <wlr/util/log.h>
@@ -23,30 +31,278 @@ static void keyboard_handle_modifiers(struct wl_listener *listener,
                                      &keyboard->wlr_keyboard->modifiers);
 }
 
+static void spawn(const char *command) {
+  /* Fork twice so the child is reparented to init and never becomes a
+   * zombie of ours. */
+  pid_t pid = fork();
+  if (pid < 0) {
+    wlr_log(WLR_ERROR, "failed to fork: %s", strerror(errno));
+    return;
+  }
+
+  if (pid == 0) {
+    setsid();
+    if (fork() == 0) {
+      execl("/bin/sh", "/bin/sh", "-c", command, (char *)NULL);
+      _exit(EXIT_FAILURE);
+    }
+    _exit(EXIT_SUCCESS);
+  }
+
+  waitpid(pid, NULL, 0);
+}
+
+static void switch_workspace(struct nora_server *server, uint32_t id) {
+  struct nora_output *output = nora_get_current_output(server);
+  if (output == NULL) {
+    return;
+  }
+
+  struct nora_tree_output *tree_output = output->tree_output;
+  struct nora_tree_workspace *workspace =
+      nora_tree_output_workspace(tree_output, id);
+  if (workspace == nora_tree_output_current_workspace(tree_output)) {
+    return;
+  }
+
+  nora_tree_output_set_current_workspace(tree_output, workspace);
+  wlr_seat_keyboard_notify_clear_focus(server->input.seat);
+  wlr_output_schedule_frame(output->wlr_output);
+}
+
+static void cycle_focus(struct nora_server *server, bool forward) {
+  struct nora_output *output = nora_get_current_output(server);
+  if (output == NULL) {
+    return;
+  }
+
+  struct nora_tree_workspace *workspace =
+      nora_tree_output_current_workspace(output->tree_output);
+  if (workspace == NULL || wl_list_empty(&workspace->containers)) {
+    return;
+  }
+
+  struct nora_tree_container *focused =
+      nora_tree_root_find_container_by_surface(
+          server->tree_root, server->input.seat->keyboard_state.focused_surface);
+
+  /* Start from the focused container if it lives in this workspace,
+   * otherwise from the list head. */
+  struct wl_list *start = &workspace->containers;
+  if (focused != NULL && focused->parent == NULL &&
+      focused->workspace == workspace) {
+    start = &focused->link;
+  }
+
+  struct wl_list *link = start;
+  do {
+    link = forward ? link->next : link->prev;
+    if (link == &workspace->containers) {
+      continue;
+    }
+
+    struct nora_tree_container *container =
+        wl_container_of(link, container, link);
+    if (container->mapped) {
+      nora_focus_view(container->view, container->surface);
+      return;
+    }
+  } while (link != start);
+}
+
+static void set_layout(struct nora_server *server, uint32_t layout) {
+  struct nora_tree_container *focused =
+      nora_tree_root_find_container_by_surface(
+          server->tree_root, server->input.seat->keyboard_state.focused_surface);
+  if (focused == NULL || focused->workspace == NULL ||
+      focused->view->kind != NORA_VIEW_KIND_XDG_TOPLEVEL) {
+    return;
+  }
+
+  nora_layout_set_kind(focused->view, layout);
+  nora_layout_arrange(focused->workspace);
+}
+
+static void run_binding(struct nora_server *server,
+                        const struct nora_binding *binding) {
+  switch (binding->action) {
+  case NORA_BINDING_ACTION_SPAWN:
+    spawn(binding->arg.command);
+    break;
+  case NORA_BINDING_ACTION_WORKSPACE:
+    switch_workspace(server, binding->arg.workspace);
+    break;
+  case NORA_BINDING_ACTION_FOCUS_NEXT:
+    cycle_focus(server, true);
+    break;
+  case NORA_BINDING_ACTION_FOCUS_PREVIOUS:
+    cycle_focus(server, false);
+    break;
+  case NORA_BINDING_ACTION_MODE:
+    server->input.bindings.current_mode = binding->arg.mode;
+    wlr_log(WLR_INFO, "Switched to binding mode (%s)",
+            server->input.bindings.modes[binding->arg.mode].name);
+    break;
+  case NORA_BINDING_ACTION_LAYOUT:
+    set_layout(server, binding->arg.layout);
+    break;
+  case NORA_BINDING_ACTION_QUIT:
+    wl_display_terminate(server->wl_display);
+    break;
+  }
+}
+
+static void keyboard_stop_repeat(struct nora_keyboard *keyboard) {
+  keyboard->repeat_binding = NULL;
+  if (keyboard->repeat_source != NULL) {
+    wl_event_source_timer_update(keyboard->repeat_source, 0);
+  }
+}
+
+static int keyboard_handle_repeat(void *data) {
+  struct nora_keyboard *keyboard = data;
+  if (keyboard->repeat_binding == NULL) {
+    return 0;
+  }
+
+  int32_t rate = keyboard->wlr_keyboard->repeat_info.rate;
+  if (rate > 0) {
+    wl_event_source_timer_update(keyboard->repeat_source, 1000 / rate);
+  }
+
+  run_binding(keyboard->server, keyboard->repeat_binding);
+  return 0;
+}
+
+static void keyboard_start_repeat(struct nora_keyboard *keyboard,
+                                  uint32_t keycode,
+                                  const struct nora_binding *binding) {
+  if (keyboard->wlr_keyboard->repeat_info.rate <= 0 ||
+      keyboard->repeat_source == NULL) {
+    return;
+  }
+
+  keyboard->repeat_binding = binding;
+  keyboard->repeat_keycode = keycode;
+  wl_event_source_timer_update(keyboard->repeat_source,
+                               keyboard->wlr_keyboard->repeat_info.delay);
+}
+
+static bool keyboard_press_binding(struct nora_keyboard *keyboard,
+                                   uint32_t keycode) {
+  struct nora_server *server = keyboard->server;
+  struct wlr_keyboard *wlr_keyboard = keyboard->wlr_keyboard;
+
+  /* Bindings match the keysyms of the first shift level, so that e.g.
+   * Alt+Shift+1 is not seen as Alt+exclam. */
+  xkb_keycode_t xkb_keycode = keycode + 8;
+  const xkb_keysym_t *syms;
+  int nsyms = xkb_keymap_key_get_syms_by_level(
+      wlr_keyboard->keymap, xkb_keycode,
+      xkb_state_key_get_layout(wlr_keyboard->xkb_state, xkb_keycode), 0,
+      &syms);
+
+  uint32_t modifiers = wlr_keyboard_get_modifiers(wlr_keyboard);
+  for (int i = 0; i < nsyms; i++) {
+    const struct nora_binding *binding =
+        nora_bindings_lookup(&server->input.bindings, modifiers, syms[i]);
+    if (binding == NULL) {
+      continue;
+    }
+
+    /* A press which cannot be recorded goes to the client, so that its
+     * release does as well. */
+    struct nora_held_key *held = wl_array_add(&keyboard->held, sizeof(*held));
+    if (held == NULL) {
+      wlr_log(WLR_ERROR, "failed to record held key, passing it on");
+      return false;
+    }
+
+    held->keycode = keycode;
+    held->binding = binding;
+
+    if (binding->flags & NORA_BINDING_RELEASE) {
+      return true;
+    }
+
+    run_binding(server, binding);
+    if (binding->flags & NORA_BINDING_REPEAT) {
+      keyboard_start_repeat(keyboard, keycode, binding);
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+static bool keyboard_release_binding(struct nora_keyboard *keyboard,
+                                     uint32_t keycode) {
+  if (keyboard->repeat_binding != NULL &&
+      keyboard->repeat_keycode == keycode) {
+    keyboard_stop_repeat(keyboard);
+  }
+
+  struct nora_held_key *held = keyboard->held.data;
+  size_t count = keyboard->held.size / sizeof(*held);
+  for (size_t i = 0; i < count; ++i) {
+    if (held[i].keycode != keycode) {
+      continue;
+    }
+
+    const struct nora_binding *binding = held[i].binding;
+    held[i] = held[count - 1];
+    keyboard->held.size -= sizeof(*held);
+
+    if (binding->flags & NORA_BINDING_RELEASE) {
+      run_binding(keyboard->server, binding);
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+static void track_input_latency(struct nora_server *server,
+                                uint32_t time_msec) {
+  if (!server->config.track_input_latency) {
+    return;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t now_nsec = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+  /* Device timestamps are CLOCK_MONOTONIC milliseconds truncated to 32 bits
+   * on libinput. Fall back to the time the event arrived when it does not
+   * look like one, e.g. on nested backends. */
+  uint32_t age_msec = (uint32_t)(now_nsec / 1000000) - time_msec;
+  int64_t input_nsec =
+      age_msec < 1000 ? now_nsec - (int64_t)age_msec * 1000000 : now_nsec;
+
+  struct nora_output *output;
+  wl_list_for_each(output, &server->desktop.outputs, link) {
+    nora_input_latency_tag(&output->input_latency, input_nsec);
+  }
+}
+
 static void keyboard_handle_key(struct wl_listener *listener, void *data) {
   /* This event is raised when a key is pressed or released. */
   struct nora_keyboard *keyboard = wl_container_of(listener, keyboard, key);
   struct nora_server *server = keyboard->server;
   struct wlr_keyboard_key_event *event = data;
   struct wlr_seat *seat = server->input.seat;
-
-  /* Translate libinput keycode -> xkbcommon */
-  // uint32_t keycode = event->keycode + 8;
-  /* Get a list of keysyms based on the keymap for this keyboard */
-  // const xkb_keysym_t *syms;
-  // int nsyms = xkb_state_key_get_syms(
-  //		keyboard->wlr_keyboard->xkb_state, keycode, &syms);
+  track_input_latency(server, event->time_msec);
 
   bool handled = false;
-  // uint32_t modifiers = wlr_keyboard_get_modifiers(keyboard->wlr_keyboard);
-  // if ((modifiers & WLR_MODIFIER_ALT) &&
-  //		event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-  //	/* If alt is held down and this button was _pressed_, we attempt to
-  //	 * process it as a compositor keybinding. */
-  //	for (int i = 0; i < nsyms; i++) {
-  //		handled = handle_keybinding(server, syms[i]);
-  //	}
-  // }
+  if (event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+    /* Any other key interrupts a repeating binding. */
+    keyboard_stop_repeat(keyboard);
+    handled = keyboard_press_binding(keyboard, event->keycode);
+  } else {
+    handled = keyboard_release_binding(keyboard, event->keycode);
+  }
 
   if (!handled) {
     /* Otherwise, we pass it along to the client. */
@@ -62,13 +318,76 @@ static void keyboard_handle_destroy(struct wl_listener *listener, void *data) {
    * and should be destroyed.
    */
   struct nora_keyboard *keyboard = wl_container_of(listener, keyboard, destroy);
+  if (keyboard->repeat_source != NULL) {
+    wl_event_source_remove(keyboard->repeat_source);
+  }
   wl_list_remove(&keyboard->modifiers.link);
   wl_list_remove(&keyboard->key.link);
   wl_list_remove(&keyboard->destroy.link);
   wl_list_remove(&keyboard->link);
+  wl_array_release(&keyboard->held);
   free(keyboard);
 }
 
+static bool rule_name_equal(const char *a, const char *b) {
+  return strcmp(a ? a : "", b ? b : "") == 0;
+}
+
+static char *rule_name_dup(const char *name) {
+  return name ? strdup(name) : NULL;
+}
+
+static struct xkb_keymap *
+keymap_from_names(struct nora_server *server,
+                  const struct xkb_rule_names *names) {
+  struct nora_keymap *keymap;
+  wl_list_for_each(keymap, &server->input.keymaps, link) {
+    if (rule_name_equal(keymap->rules, names->rules) &&
+        rule_name_equal(keymap->model, names->model) &&
+        rule_name_equal(keymap->layout, names->layout) &&
+        rule_name_equal(keymap->variant, names->variant) &&
+        rule_name_equal(keymap->options, names->options)) {
+      return keymap->keymap;
+    }
+  }
+
+  struct xkb_keymap *xkb_keymap = xkb_keymap_new_from_names(
+      server->input.xkb_context, names, XKB_KEYMAP_COMPILE_NO_FLAGS);
+  if (xkb_keymap == NULL) {
+    wlr_log(WLR_ERROR, "failed to compile keymap");
+    return NULL;
+  }
+
+  keymap = calloc(1, sizeof(*keymap));
+  keymap->rules = rule_name_dup(names->rules);
+  keymap->model = rule_name_dup(names->model);
+  keymap->layout = rule_name_dup(names->layout);
+  keymap->variant = rule_name_dup(names->variant);
+  keymap->options = rule_name_dup(names->options);
+  keymap->keymap = xkb_keymap;
+
+  wl_list_insert(&server->input.keymaps, &keymap->link);
+
+  return xkb_keymap;
+}
+
+void nora_input_destroy_keymaps(struct nora_server *server) {
+  struct nora_keymap *keymap, *tmp;
+  wl_list_for_each_safe(keymap, tmp, &server->input.keymaps, link) {
+    wl_list_remove(&keymap->link);
+    xkb_keymap_unref(keymap->keymap);
+    free(keymap->rules);
+    free(keymap->model);
+    free(keymap->layout);
+    free(keymap->variant);
+    free(keymap->options);
+    free(keymap);
+  }
+
+  xkb_context_unref(server->input.xkb_context);
+  server->input.xkb_context = NULL;
+}
+
 static void new_keyboard(struct nora_server *server,
                          struct wlr_input_device *device) {
   struct wlr_keyboard *wlr_keyboard = wlr_keyboard_from_input_device(device);
@@ -76,18 +395,22 @@ static void new_keyboard(struct nora_server *server,
   struct nora_keyboard *keyboard = calloc(1, sizeof(struct nora_keyboard));
   keyboard->server = server;
   keyboard->wlr_keyboard = wlr_keyboard;
+  wl_array_init(&keyboard->held);
 
   /* We need to prepare an XKB keymap and assign it to the keyboard. This
-   * assumes the defaults (e.g. layout = "us"). */
-  struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-  struct xkb_keymap *keymap =
-      xkb_keymap_new_from_names(context, NULL, XKB_KEYMAP_COMPILE_NO_FLAGS);
-
-  wlr_keyboard_set_keymap(wlr_keyboard, keymap);
-  xkb_keymap_unref(keymap);
-  xkb_context_unref(context);
+   * assumes the defaults (e.g. layout = "us"). The compiled keymap is shared
+   * with every other keyboard using the same names. */
+  struct xkb_rule_names names = {0};
+  struct xkb_keymap *keymap = keymap_from_names(server, &names);
+  if (keymap != NULL) {
+    wlr_keyboard_set_keymap(wlr_keyboard, keymap);
+  }
   wlr_keyboard_set_repeat_info(wlr_keyboard, 25, 600);
 
+  keyboard->repeat_source = wl_event_loop_add_timer(
+      wl_display_get_event_loop(server->wl_display), keyboard_handle_repeat,
+      keyboard);
+
   /* Here we set up listeners for keyboard events. */
   keyboard->modifiers.notify = keyboard_handle_modifiers;
   wl_signal_add(&wlr_keyboard->events.modifiers, &keyboard->modifiers);
@@ -112,6 +435,13 @@ static void new_pointer(struct nora_server *server,
 }
 
 static void reset_cursor_mode(struct nora_server *server) {
+  /* Deliver the final size of an interactive resize, the view keeps applying
+   * it on its own once the client acks. */
+  if (server->input.cursor_mode == NORA_CURSOR_RESIZE &&
+      server->input.grabbed_view != NULL) {
+    nora_view_flush_resize(server->input.grabbed_view);
+  }
+
   /* Reset the cursor mode to passthrough. */
   server->input.cursor_mode = NORA_CURSOR_PASSTHROUGH;
   server->input.grabbed_view = NULL;
@@ -125,6 +455,7 @@ static void process_cursor_move(struct nora_server *server, uint32_t time) {
     wlr_scene_node_set_position(&view->xdg_toplevel.scene_tree->node,
                                 server->input.cursor->x - server->input.grab_x,
                                 server->input.cursor->y - server->input.grab_y);
+    nora_tree_container_update_bounds(view->container);
     return;
   }
 
@@ -139,9 +470,8 @@ static void process_cursor_resize(struct nora_server *server, uint32_t time) {
    * on one or two axes, but can also move the view if you resize from the top
    * or left edges (or top-left corner).
    *
-   * Note that I took some shortcuts here. In a more fleshed-out compositor,
-   * you'd wait for the client to prepare a buffer at the new size, then
-   * commit any movement that was prepared.
+   * The view is not moved here, nora_view_resize throttles configures to one
+   * in flight and moves the view once the client commits a matching buffer.
    */
   struct nora_view *view = server->input.grabbed_view;
 
@@ -181,18 +511,23 @@ static void process_cursor_resize(struct nora_server *server, uint32_t time) {
     }
   }
 
-  struct wlr_box geo_box;
-  wlr_xdg_surface_get_geometry(view->xdg_toplevel.xdg_toplevel->base, &geo_box);
-  wlr_scene_node_set_position(&view->xdg_toplevel.scene_tree->node,
-                              new_left - geo_box.x, new_top - geo_box.y);
+  struct wlr_box box = {
+      .x = new_left,
+      .y = new_top,
+      .width = new_right - new_left,
+      .height = new_bottom - new_top,
+  };
+  nora_view_resize(view, box, server->input.resize_edges);
+}
 
-  int new_width = new_right - new_left;
-  int new_height = new_bottom - new_top;
-  wlr_xdg_toplevel_set_size(view->xdg_toplevel.xdg_toplevel, new_width,
-                            new_height);
+static bool should_coalesce_cursor_motion(struct nora_server *server) {
+  /* Grabs are cheap and need to track the pointer closely. */
+  return server->config.coalesce_pointer_motion &&
+         server->input.cursor_mode == NORA_CURSOR_PASSTHROUGH;
 }
 
 static void process_cursor_motion(struct nora_server *server, uint32_t time) {
+  NORA_TRACE_FUNC();
   /* If the mode is non-passthrough, delegate to those functions. */
   if (server->input.cursor_mode == NORA_CURSOR_MOVE) {
     process_cursor_move(server, time);
@@ -203,6 +538,10 @@ static void process_cursor_motion(struct nora_server *server, uint32_t time) {
   }
 
   /* Otherwise, find the view under the pointer and send the event along. */
+  server->input.stats.motion_hit_tests++;
+  server->input.motion_pending = false;
+  server->input.motion_processed_this_frame = true;
+
   double sx, sy;
   struct wlr_seat *seat = server->input.seat;
   struct wlr_surface *surface = NULL;
@@ -250,6 +589,16 @@ void nora_input_cursor_motion(struct wl_listener *listener, void *data) {
    * the cursor around without any input. */
   wlr_cursor_move(server->input.cursor, &event->pointer->base, event->delta_x,
                   event->delta_y);
+  track_input_latency(server, event->time_msec);
+
+  server->input.stats.motion_events++;
+  if (should_coalesce_cursor_motion(server)) {
+    /* The cursor image has moved, the rest waits for the pointer frame. */
+    server->input.motion_pending = true;
+    server->input.motion_time_msec = event->time_msec;
+    return;
+  }
+
   process_cursor_motion(server, event->time_msec);
 }
 
@@ -266,6 +615,15 @@ void nora_input_cursor_motion_absolute(struct wl_listener *listener,
   struct wlr_pointer_motion_absolute_event *event = data;
   wlr_cursor_warp_absolute(server->input.cursor, &event->pointer->base,
                            event->x, event->y);
+  track_input_latency(server, event->time_msec);
+
+  server->input.stats.motion_events++;
+  if (should_coalesce_cursor_motion(server)) {
+    server->input.motion_pending = true;
+    server->input.motion_time_msec = event->time_msec;
+    return;
+  }
+
   process_cursor_motion(server, event->time_msec);
 }
 
@@ -275,6 +633,13 @@ void nora_input_cursor_button(struct wl_listener *listener, void *data) {
   struct nora_server *server =
       wl_container_of(listener, server, input.cursor_button);
   struct wlr_pointer_button_event *event = data;
+  track_input_latency(server, event->time_msec);
+  /* Focus has to be resolved for the latest position before the button is
+   * delivered. */
+  if (server->input.motion_pending) {
+    process_cursor_motion(server, server->input.motion_time_msec);
+  }
+
   /* Notify the client with pointer focus that a button press has occurred */
   wlr_seat_pointer_notify_button(server->input.seat, event->time_msec,
                                  event->button, event->state);
@@ -298,6 +663,12 @@ void nora_input_cursor_axis(struct wl_listener *listener, void *data) {
   struct nora_server *server =
       wl_container_of(listener, server, input.cursor_axis);
   struct wlr_pointer_axis_event *event = data;
+  track_input_latency(server, event->time_msec);
+  /* Scrolling goes to the surface under the latest position. */
+  if (server->input.motion_pending) {
+    process_cursor_motion(server, server->input.motion_time_msec);
+  }
+
   /* Notify the client with pointer focus of the axis event. */
   wlr_seat_pointer_notify_axis(server->input.seat, event->time_msec,
                                event->orientation, event->delta,
@@ -311,10 +682,47 @@ void nora_input_cursor_frame(struct wl_listener *listener, void *data) {
    * same time, in which case a frame event won't be sent in between. */
   struct nora_server *server =
       wl_container_of(listener, server, input.cursor_frame);
+
+  if (server->input.motion_pending) {
+    struct wlr_output *cursor_output = wlr_output_layout_output_at(
+        server->desktop.output_layout, server->input.cursor->x,
+        server->input.cursor->y);
+    if (server->config.cap_pointer_motion_to_refresh &&
+        server->input.motion_processed_this_frame && cursor_output != NULL) {
+      /* Already resolved focus during this output frame, the pending motion
+       * and its frame are sent from nora_input_output_frame. Without damage
+       * nothing else asks for that frame, e.g. with a hardware cursor. */
+      wlr_output_schedule_frame(cursor_output);
+      return;
+    }
+
+    process_cursor_motion(server, server->input.motion_time_msec);
+  }
+
   /* Notify the client with pointer focus of the frame event. */
   wlr_seat_pointer_notify_frame(server->input.seat);
 }
 
+void nora_input_output_frame(struct nora_output *output) {
+  /* Called by every output frame, flushes motion that was held back by the
+   * refresh cap once the output under the cursor starts a new frame. */
+  struct nora_server *server = output->server;
+
+  struct wlr_output *cursor_output = wlr_output_layout_output_at(
+      server->desktop.output_layout, server->input.cursor->x,
+      server->input.cursor->y);
+  if (cursor_output != output->wlr_output) {
+    return;
+  }
+
+  server->input.motion_processed_this_frame = false;
+
+  if (server->input.motion_pending) {
+    process_cursor_motion(server, server->input.motion_time_msec);
+    wlr_seat_pointer_notify_frame(server->input.seat);
+  }
+}
+
 void nora_new_input(struct wl_listener *listener, void *data) {
   /* This is event is forwareded when a new input device is made avaliable
    * the seat.
@@ -1,6 +1,8 @@
 #ifndef NORA_INPUT_H_
 #define NORA_INPUT_H_
 
+#include <wayland-server-core.h>
+
 void nora_input_cursor_motion(struct wl_listener *listener, void *data);
 void nora_input_cursor_motion_absolute(struct wl_listener *listener, void *data);
 void nora_input_cursor_button(struct wl_listener *listener, void *data);
@@ -10,5 +12,11 @@ void nora_new_input(struct wl_listener *listener, void *data);
 void nora_input_seat_request_set_selection(struct wl_listener *listener, void *data);
 void nora_input_seat_request_cursor(struct wl_listener *listener, void *data);
 
+struct nora_output;
+void nora_input_output_frame(struct nora_output *output);
+
+struct nora_server;
+void nora_input_destroy_keymaps(struct nora_server *server);
+
 #endif // NORA_INPUT_H_
 
@@ -0,0 +1,546 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/util/edges.h>
+#include <wlr/util/log.h>
+
+#include "layout.h"
+#include "output.h"
+#include "server.h"
+#include "trace.h"
+#include "tree.h"
+#include "view.h"
+
+static struct nora_layout_node *nora_layout_node_create(void) {
+  struct nora_layout_node *node = calloc(1, sizeof(*node));
+  if (node == NULL) {
+    return NULL;
+  }
+
+  wl_list_init(&node->link);
+  wl_list_init(&node->children);
+  return node;
+}
+
+struct nora_layout_node *nora_layout_create(void) {
+  struct nora_layout_node *root = nora_layout_node_create();
+  if (root != NULL) {
+    root->kind = NORA_LAYOUT_SPLIT_HORIZONTAL;
+    root->shown = true;
+  }
+
+  return root;
+}
+
+void nora_layout_destroy(struct nora_layout_node *root) {
+  struct nora_layout_node *child, *tmp;
+  wl_list_for_each_safe(child, tmp, &root->children, link) {
+    nora_layout_destroy(child);
+  }
+
+  if (root->view != NULL) {
+    root->view->xdg_toplevel.tile.node = NULL;
+  }
+
+  wl_list_remove(&root->link);
+  free(root);
+}
+
+static void nora_layout_node_mark_dirty(struct nora_layout_node *node) {
+  for (; node != NULL; node = node->parent) {
+    node->dirty = true;
+  }
+}
+
+static void nora_layout_save_buffer(struct wlr_scene_buffer *buffer, int sx,
+                                    int sy, void *data) {
+  struct wlr_scene_tree *saved = data;
+  if (buffer->buffer == NULL) {
+    return;
+  }
+
+  struct wlr_scene_buffer *copy = wlr_scene_buffer_create(saved, NULL);
+  if (copy == NULL) {
+    return;
+  }
+
+  wlr_scene_buffer_set_dest_size(copy, buffer->dst_width, buffer->dst_height);
+  wlr_scene_buffer_set_opaque_region(copy, &buffer->opaque_region);
+  wlr_scene_buffer_set_source_box(copy, &buffer->src_box);
+  wlr_scene_buffer_set_transform(copy, buffer->transform);
+  wlr_scene_node_set_position(&copy->node, sx, sy);
+  // Locks the buffer, the client gets it back once the copy is gone.
+  wlr_scene_buffer_set_buffer(copy, buffer->buffer);
+}
+
+/* Shows a copy of the view's current buffers in place of its surfaces until
+ * the transaction is applied, so a buffer committed for the new size is not
+ * drawn at the old position. */
+static void nora_layout_view_save(struct nora_view *view) {
+  struct wlr_scene_node *node = &view->xdg_toplevel.scene_tree->node;
+  if (view->xdg_toplevel.tile.saved != NULL || !node->enabled) {
+    return;
+  }
+
+  struct wlr_scene_tree *saved = wlr_scene_tree_create(node->parent);
+  if (saved == NULL) {
+    return;
+  }
+
+  wlr_scene_node_set_position(&saved->node, node->x, node->y);
+  wlr_scene_node_place_above(&saved->node, node);
+  wlr_scene_node_for_each_buffer(node, nora_layout_save_buffer, saved);
+
+  wlr_scene_node_set_enabled(node, false);
+  view->xdg_toplevel.tile.saved = saved;
+}
+
+void nora_layout_view_restore(struct nora_view *view) {
+  if (view->xdg_toplevel.tile.saved == NULL) {
+    return;
+  }
+
+  wlr_scene_node_destroy(&view->xdg_toplevel.tile.saved->node);
+  view->xdg_toplevel.tile.saved = NULL;
+  wlr_scene_node_set_enabled(&view->xdg_toplevel.scene_tree->node,
+                             !view->xdg_toplevel.hidden);
+}
+
+static void nora_layout_transaction_apply(
+    struct nora_layout_transaction *transaction) {
+  NORA_TRACE_FUNC();
+  wl_event_source_timer_update(transaction->timer, 0);
+
+  struct nora_view *view, *tmp;
+  wl_list_for_each_safe(view, tmp, &transaction->views, xdg_toplevel.tile.link) {
+    wl_list_remove(&view->xdg_toplevel.tile.link);
+    wl_list_init(&view->xdg_toplevel.tile.link);
+    view->xdg_toplevel.tile.waiting = false;
+    nora_layout_view_restore(view);
+
+    struct nora_layout_node *node = view->xdg_toplevel.tile.node;
+    if (node == NULL || view->xdg_toplevel.fullscreen) {
+      continue;
+    }
+
+    // The scene offsets xdg surfaces by their window geometry.
+    struct wlr_box geo_box;
+    wlr_xdg_surface_get_geometry(view->xdg_toplevel.xdg_toplevel->base,
+                                 &geo_box);
+
+    struct wlr_scene_node *scene_node = &view->xdg_toplevel.scene_tree->node;
+    wlr_scene_node_set_position(scene_node, node->box.x - geo_box.x,
+                                node->box.y - geo_box.y);
+    wlr_scene_node_set_enabled(scene_node,
+                               node->shown && !view->xdg_toplevel.hidden);
+    // The visible tab may have changed.
+    nora_view_update_suspended(view);
+
+    nora_tree_container_update_bounds(view->container);
+  }
+
+  transaction->waiting = 0;
+  wlr_output_schedule_frame(transaction->output->output->wlr_output);
+}
+
+static int nora_layout_transaction_handle_timeout(void *data) {
+  struct nora_layout_transaction *transaction = data;
+
+  wlr_log(WLR_DEBUG, "Layout transaction timed out waiting for %zu views",
+          transaction->waiting);
+  nora_layout_transaction_apply(transaction);
+  return 0;
+}
+
+void nora_layout_transaction_init(struct nora_layout_transaction *transaction,
+                                  struct nora_tree_output *output,
+                                  struct wl_event_loop *event_loop) {
+  transaction->output = output;
+  transaction->waiting = 0;
+  wl_list_init(&transaction->views);
+  transaction->timer = wl_event_loop_add_timer(
+      event_loop, nora_layout_transaction_handle_timeout, transaction);
+}
+
+void nora_layout_transaction_finish(
+    struct nora_layout_transaction *transaction) {
+  struct nora_view *view, *tmp;
+  wl_list_for_each_safe(view, tmp, &transaction->views, xdg_toplevel.tile.link) {
+    wl_list_remove(&view->xdg_toplevel.tile.link);
+    wl_list_init(&view->xdg_toplevel.tile.link);
+    view->xdg_toplevel.tile.transaction = NULL;
+    view->xdg_toplevel.tile.waiting = false;
+    nora_layout_view_restore(view);
+  }
+
+  transaction->waiting = 0;
+  if (transaction->timer != NULL) {
+    wl_event_source_remove(transaction->timer);
+    transaction->timer = NULL;
+  }
+}
+
+bool nora_layout_transaction_pending(
+    struct nora_layout_transaction *transaction) {
+  return transaction->waiting > 0;
+}
+
+static void send_frame_done_iterator(struct wlr_surface *surface, int sx,
+                                     int sy, void *data) {
+  wlr_surface_send_frame_done(surface, data);
+}
+
+void nora_layout_transaction_send_frame_done(
+    struct nora_layout_transaction *transaction, const struct timespec *when) {
+  struct nora_view *view;
+  wl_list_for_each(view, &transaction->views, xdg_toplevel.tile.link) {
+    if (view->xdg_toplevel.tile.saved != NULL) {
+      wlr_xdg_surface_for_each_surface(view->xdg_toplevel.xdg_toplevel->base,
+                                       send_frame_done_iterator,
+                                       (void *)when);
+    }
+  }
+}
+
+static void nora_layout_transaction_add(
+    struct nora_layout_transaction *transaction, struct nora_view *view,
+    bool wait) {
+  struct nora_layout_node *node = view->xdg_toplevel.tile.node;
+
+  if (wl_list_empty(&view->xdg_toplevel.tile.link)) {
+    wl_list_insert(transaction->views.prev, &view->xdg_toplevel.tile.link);
+  }
+  view->xdg_toplevel.tile.transaction = transaction;
+
+  // Fullscreen views keep the size of the output until they leave it.
+  if (view->xdg_toplevel.fullscreen) {
+    return;
+  }
+
+  // Only a new size needs the client, moving the view is up to us.
+  if (view->xdg_toplevel.tile.width == node->box.width &&
+      view->xdg_toplevel.tile.height == node->box.height) {
+    return;
+  }
+
+  view->xdg_toplevel.tile.width = node->box.width;
+  view->xdg_toplevel.tile.height = node->box.height;
+  view->xdg_toplevel.tile.serial = wlr_xdg_toplevel_set_size(
+      view->xdg_toplevel.xdg_toplevel, node->box.width, node->box.height);
+
+  // Views which are not shown have nothing to tear, do not hold the layout
+  // for them.
+  if (wait && node->shown && !view->xdg_toplevel.hidden &&
+      !view->xdg_toplevel.tile.waiting) {
+    view->xdg_toplevel.tile.waiting = true;
+    transaction->waiting++;
+    nora_layout_view_save(view);
+  }
+}
+
+static void nora_layout_node_arrange(struct nora_layout_transaction *transaction,
+                                     struct nora_layout_node *node,
+                                     const struct wlr_box *box, bool shown,
+                                     bool wait) {
+  if (!node->dirty && node->shown == shown && wlr_box_equal(&node->box, box)) {
+    return;
+  }
+
+  node->box = *box;
+  node->shown = shown;
+  node->dirty = false;
+
+  if (node->view != NULL) {
+    nora_layout_transaction_add(transaction, node->view, wait);
+    return;
+  }
+
+  int count = wl_list_length(&node->children);
+  int i = 0;
+
+  struct nora_layout_node *child;
+  wl_list_for_each(child, &node->children, link) {
+    struct wlr_box child_box = *box;
+    bool child_shown = shown;
+
+    // Shares are rounded so the children always cover the box exactly.
+    switch (node->kind) {
+    case NORA_LAYOUT_SPLIT_HORIZONTAL:
+      child_box.x = box->x + box->width * i / count;
+      child_box.width = box->x + box->width * (i + 1) / count - child_box.x;
+      break;
+    case NORA_LAYOUT_SPLIT_VERTICAL:
+      child_box.y = box->y + box->height * i / count;
+      child_box.height = box->y + box->height * (i + 1) / count - child_box.y;
+      break;
+    case NORA_LAYOUT_TABBED:
+    case NORA_LAYOUT_STACKED:
+      child_shown = shown && child == node->focused;
+      break;
+    }
+
+    nora_layout_node_arrange(transaction, child, &child_box, child_shown,
+                             wait);
+    ++i;
+  }
+}
+
+void nora_layout_arrange(struct nora_tree_workspace *workspace) {
+  NORA_TRACE_FUNC();
+  // Workspaces of a detached output are laid out again once another output
+  // takes them over.
+  if (workspace->layout == NULL || workspace->output->output == NULL) {
+    return;
+  }
+
+  struct nora_tree_output *tree_output = workspace->output;
+  struct nora_layout_transaction *transaction = &tree_output->transaction;
+
+  struct wlr_box box;
+  nora_output_usable_box(tree_output->output, &box);
+
+  // Workspaces in the background are configured, but nothing waits for them.
+  bool wait = nora_tree_output_current_workspace(tree_output) == workspace;
+  bool was_pending = nora_layout_transaction_pending(transaction);
+
+  nora_layout_node_arrange(transaction, workspace->layout, &box, true, wait);
+
+  if (wl_list_empty(&transaction->views)) {
+    return;
+  }
+
+  if (!nora_layout_transaction_pending(transaction)) {
+    // Nothing to wait for, e.g. the views only moved.
+    nora_layout_transaction_apply(transaction);
+  } else if (!was_pending) {
+    // Arrangements made while a transaction is in flight join it, and keep
+    // its deadline.
+    wl_event_source_timer_update(transaction->timer,
+                                 NORA_LAYOUT_TRANSACTION_TIMEOUT_MSEC);
+  }
+}
+
+// Returns the leaf new views are opened next to.
+static struct nora_layout_node *
+nora_layout_focused_leaf(struct nora_layout_node *node) {
+  while (node->view == NULL) {
+    if (node->focused != NULL) {
+      node = node->focused;
+    } else if (!wl_list_empty(&node->children)) {
+      node = wl_container_of(node->children.prev, node, link);
+    } else {
+      return NULL;
+    }
+  }
+
+  return node;
+}
+
+void nora_layout_insert_view(struct nora_tree_workspace *workspace,
+                             struct nora_view *view) {
+  assert(view->kind == NORA_VIEW_KIND_XDG_TOPLEVEL);
+  assert(view->xdg_toplevel.tile.node == NULL);
+
+  struct nora_layout_node *leaf = nora_layout_node_create();
+  if (leaf == NULL) {
+    wlr_log(WLR_ERROR, "failed to allocate layout node");
+    return;
+  }
+
+  leaf->view = view;
+  view->xdg_toplevel.tile.node = leaf;
+  view->xdg_toplevel.tile.width = 0;
+  view->xdg_toplevel.tile.height = 0;
+
+  struct wlr_xdg_toplevel *toplevel = view->xdg_toplevel.xdg_toplevel;
+  if (wl_resource_get_version(toplevel->resource) >=
+      XDG_TOPLEVEL_STATE_TILED_LEFT_SINCE_VERSION) {
+    wlr_xdg_toplevel_set_tiled(toplevel, WLR_EDGE_TOP | WLR_EDGE_BOTTOM |
+                                             WLR_EDGE_LEFT | WLR_EDGE_RIGHT);
+  }
+
+  struct nora_layout_node *root = workspace->layout;
+  struct nora_layout_node *focused = nora_layout_focused_leaf(root);
+
+  struct nora_layout_node *parent;
+  if (focused == NULL) {
+    parent = root;
+    wl_list_insert(root->children.prev, &leaf->link);
+  } else if (focused->parent->kind == NORA_LAYOUT_TABBED ||
+             focused->parent->kind == NORA_LAYOUT_STACKED ||
+             wl_list_length(&focused->parent->children) < 2) {
+    // Siblings of a tabbed view keep their box, and so does a lone view once
+    // the split is made.
+    parent = focused->parent;
+    wl_list_insert(&focused->link, &leaf->link);
+  } else {
+    /* Split the focused view in two rather than squeezing the new view into
+     * its parent, so none of the other views of the workspace change size.
+     * The split follows the longer side. */
+    parent = nora_layout_node_create();
+    if (parent == NULL) {
+      wlr_log(WLR_ERROR, "failed to allocate layout node");
+      view->xdg_toplevel.tile.node = NULL;
+      free(leaf);
+      return;
+    }
+
+    parent->kind = focused->box.width >= focused->box.height
+                       ? NORA_LAYOUT_SPLIT_HORIZONTAL
+                       : NORA_LAYOUT_SPLIT_VERTICAL;
+    parent->parent = focused->parent;
+    parent->box = focused->box;
+    parent->shown = focused->shown;
+    if (focused->parent->focused == focused) {
+      focused->parent->focused = parent;
+    }
+    wl_list_insert(&focused->link, &parent->link);
+    wl_list_remove(&focused->link);
+
+    focused->parent = parent;
+    wl_list_insert(&parent->children, &focused->link);
+    wl_list_insert(&focused->link, &leaf->link);
+  }
+
+  leaf->parent = parent;
+  nora_layout_node_mark_dirty(parent);
+  nora_layout_focus_view(view);
+
+  nora_layout_arrange(workspace);
+}
+
+void nora_layout_remove_view(struct nora_view *view) {
+  assert(view->kind == NORA_VIEW_KIND_XDG_TOPLEVEL);
+
+  struct nora_layout_node *leaf = view->xdg_toplevel.tile.node;
+  if (leaf == NULL) {
+    return;
+  }
+
+  struct nora_layout_transaction *transaction =
+      view->xdg_toplevel.tile.transaction;
+  if (transaction != NULL) {
+    wl_list_remove(&view->xdg_toplevel.tile.link);
+    wl_list_init(&view->xdg_toplevel.tile.link);
+    nora_layout_view_restore(view);
+    if (view->xdg_toplevel.tile.waiting) {
+      view->xdg_toplevel.tile.waiting = false;
+      if (--transaction->waiting == 0) {
+        nora_layout_transaction_apply(transaction);
+      }
+    }
+    view->xdg_toplevel.tile.transaction = NULL;
+  }
+
+  struct nora_layout_node *parent = leaf->parent;
+  if (parent->focused == leaf) {
+    // Focus falls to a neighbour, like closing a tab.
+    struct wl_list *next = leaf->link.prev != &parent->children
+                               ? leaf->link.prev
+                               : leaf->link.next;
+    parent->focused = next != &parent->children
+                          ? wl_container_of(next, leaf, link)
+                          : NULL;
+  }
+
+  view->xdg_toplevel.tile.node = NULL;
+  view->xdg_toplevel.tile.serial = 0;
+  wl_list_remove(&leaf->link);
+  free(leaf);
+
+  // A split left with a single child is replaced by it.
+  if (parent->parent != NULL && wl_list_length(&parent->children) == 1) {
+    struct nora_layout_node *child =
+        wl_container_of(parent->children.next, child, link);
+    struct nora_layout_node *grandparent = parent->parent;
+
+    wl_list_remove(&child->link);
+    wl_list_insert(&parent->link, &child->link);
+    child->parent = grandparent;
+    if (grandparent->focused == parent) {
+      grandparent->focused = child;
+    }
+
+    wl_list_remove(&parent->link);
+    free(parent);
+    parent = grandparent;
+  } else if (parent->parent != NULL && wl_list_empty(&parent->children)) {
+    struct nora_layout_node *grandparent = parent->parent;
+    if (grandparent->focused == parent) {
+      grandparent->focused = NULL;
+    }
+
+    wl_list_remove(&parent->link);
+    free(parent);
+    parent = grandparent;
+  }
+
+  nora_layout_node_mark_dirty(parent);
+}
+
+void nora_layout_focus_view(struct nora_view *view) {
+  struct nora_layout_node *node = view->xdg_toplevel.tile.node;
+  if (node == NULL) {
+    return;
+  }
+
+  for (; node->parent != NULL; node = node->parent) {
+    struct nora_layout_node *parent = node->parent;
+    if (parent->focused == node) {
+      continue;
+    }
+
+    parent->focused = node;
+    // Tabbed and stacked nodes show the focused child only.
+    if (parent->kind == NORA_LAYOUT_TABBED ||
+        parent->kind == NORA_LAYOUT_STACKED) {
+      nora_layout_node_mark_dirty(parent);
+    }
+  }
+}
+
+void nora_layout_set_kind(struct nora_view *view, enum nora_layout_kind kind) {
+  struct nora_layout_node *node = view->xdg_toplevel.tile.node;
+  if (node == NULL || node->parent->kind == kind) {
+    return;
+  }
+
+  node->parent->kind = kind;
+  node->parent->focused = node;
+  nora_layout_node_mark_dirty(node->parent);
+}
+
+void nora_layout_retile_view(struct nora_view *view) {
+  struct nora_layout_node *node = view->xdg_toplevel.tile.node;
+  if (node == NULL) {
+    return;
+  }
+
+  // Forget what the client was told, so the layout box is sent again.
+  view->xdg_toplevel.tile.width = 0;
+  view->xdg_toplevel.tile.height = 0;
+  nora_layout_node_mark_dirty(node);
+}
+
+void nora_layout_view_commit(struct nora_view *view) {
+  uint32_t serial = view->xdg_toplevel.tile.serial;
+  struct wlr_xdg_surface *xdg_surface = view->xdg_toplevel.xdg_toplevel->base;
+  if (serial == 0 ||
+      (int32_t)(xdg_surface->current.configure_serial - serial) < 0) {
+    return;
+  }
+
+  view->xdg_toplevel.tile.serial = 0;
+
+  struct nora_layout_transaction *transaction =
+      view->xdg_toplevel.tile.transaction;
+  if (transaction == NULL || !view->xdg_toplevel.tile.waiting) {
+    return;
+  }
+
+  view->xdg_toplevel.tile.waiting = false;
+  if (--transaction->waiting == 0) {
+    nora_layout_transaction_apply(transaction);
+  }
+}
@@ -0,0 +1,110 @@
+#ifndef NORA_LAYOUT_H_
+#define NORA_LAYOUT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <wayland-server-core.h>
+#include <wlr/util/box.h>
+
+struct nora_tree_output;
+struct nora_tree_workspace;
+struct nora_view;
+
+// How long a transaction waits for clients to ack their configure before the
+// new layout is applied anyway.
+#define NORA_LAYOUT_TRANSACTION_TIMEOUT_MSEC 200
+
+enum nora_layout_kind {
+  // Children side by side, sharing the width.
+  NORA_LAYOUT_SPLIT_HORIZONTAL,
+  // Children on top of each other, sharing the height.
+  NORA_LAYOUT_SPLIT_VERTICAL,
+  // Children all take the whole box, only the focused one is shown.
+  NORA_LAYOUT_TABBED,
+  NORA_LAYOUT_STACKED,
+};
+
+/* A node of a workspace's tiling tree. Leaves hold a view, every other node
+ * lays out its children according to its kind.
+ *
+ * Arranging is incremental: a node is only laid out again if its box changed
+ * or it was marked dirty, so opening or closing a view only reconfigures the
+ * views whose geometry actually changes. */
+struct nora_layout_node {
+  struct wl_list link; // nora_layout_node::children
+  struct nora_layout_node *parent;
+
+  struct nora_view *view; // NULL unless a leaf
+
+  enum nora_layout_kind kind;
+  struct wl_list children;
+  // Child shown by tabbed and stacked nodes, new views are opened next to
+  // the focused leaf.
+  struct nora_layout_node *focused;
+
+  // Layout box and visibility as of the last arrangement.
+  struct wlr_box box;
+  bool shown;
+  // The children have to be laid out again even if the box did not change.
+  bool dirty;
+};
+
+/* Batches the configures of one arrangement. The scene keeps the previous
+ * layout until every shown view acked its configure and committed a buffer
+ * for it, or the timeout expired, and then switches all at once: views keep
+ * their position and visibility, and views asked to resize are shown from a
+ * copy of their buffers from before the configure. The output keeps
+ * rendering in between, and the surfaces behind the copies still get frame
+ * callbacks, clients throttled on them would never commit otherwise. */
+struct nora_layout_transaction {
+  struct nora_tree_output *output;
+
+  struct wl_list views; // nora_view::xdg_toplevel.tile.link
+  size_t waiting;
+  struct wl_event_source *timer;
+};
+
+struct nora_layout_node *nora_layout_create(void);
+void nora_layout_destroy(struct nora_layout_node *root);
+
+void nora_layout_transaction_init(struct nora_layout_transaction *transaction,
+                                  struct nora_tree_output *output,
+                                  struct wl_event_loop *event_loop);
+void nora_layout_transaction_finish(
+    struct nora_layout_transaction *transaction);
+bool nora_layout_transaction_pending(
+    struct nora_layout_transaction *transaction);
+// Sends frame callbacks to the views shown from a copy of their buffers, the
+// scene does not send them any while their surfaces are hidden.
+void nora_layout_transaction_send_frame_done(
+    struct nora_layout_transaction *transaction, const struct timespec *when);
+
+// Lays out whatever changed in the workspace and starts a transaction for it.
+void nora_layout_arrange(struct nora_tree_workspace *workspace);
+
+// Tiles the view next to the focused view of the workspace.
+void nora_layout_insert_view(struct nora_tree_workspace *workspace,
+                             struct nora_view *view);
+// The caller arranges the workspace afterwards.
+void nora_layout_remove_view(struct nora_view *view);
+// Makes the view the focused child of all of its ancestors.
+void nora_layout_focus_view(struct nora_view *view);
+// Changes the kind of the node the view was tiled in. Like focusing, this
+// only marks the layout, the caller arranges the workspace afterwards.
+void nora_layout_set_kind(struct nora_view *view, enum nora_layout_kind kind);
+// Sends the view its tiled geometry again on the next arrangement, e.g.
+// after leaving fullscreen.
+void nora_layout_retile_view(struct nora_view *view);
+
+// Drops the copy of the view's buffers shown during a transaction, its
+// surfaces are shown again unless the view was hidden in the meantime.
+void nora_layout_view_restore(struct nora_view *view);
+
+// Called on every commit of a tiled view, completes the transaction once the
+// last view acked its configure.
+void nora_layout_view_commit(struct nora_view *view);
+
+#endif // NORA_LAYOUT_H_
@@ -1,8 +1,83 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "server.h"
 
-int main(void) {
+static const char usage[] =
+    "Usage: nora [options]\n"
+    "\n"
+    "  -h, --help                   Show this help message.\n"
+    "  -F, --floating               Let views float instead of tiling them.\n"
+    "  -m, --coalesce-motion        Resolve pointer focus once per pointer\n"
+    "                               frame instead of per motion event.\n"
+    "  -M, --cap-motion-to-refresh  Resolve pointer focus at most once per\n"
+    "                               output frame, implies -m.\n"
+    "  -r, --max-render-time <ms>   Delay rendering until <ms> before the\n"
+    "                               next vblank, or 'adaptive' to estimate\n"
+    "                               it from past frames. Default: off.\n"
+    "  -l, --track-input-latency    Log input-to-present latency per output\n"
+    "                               on SIGUSR1 and exit.\n"
+    "  -t, --trace <file>           Trace from startup on. SIGUSR2 toggles\n"
+    "                               tracing and writes the trace to <file>\n"
+    "                               when stopped. Default:\n"
+    "                               /tmp/nora-<pid>.trace.json\n";
+
+int main(int argc, char **argv) {
     struct nora_server_config config = {};
 
+    static const struct option long_options[] = {
+        {"help", no_argument, NULL, 'h'},
+        {"floating", no_argument, NULL, 'F'},
+        {"coalesce-motion", no_argument, NULL, 'm'},
+        {"cap-motion-to-refresh", no_argument, NULL, 'M'},
+        {"max-render-time", required_argument, NULL, 'r'},
+        {"track-input-latency", no_argument, NULL, 'l'},
+        {"trace", required_argument, NULL, 't'},
+        {0, 0, 0, 0},
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "hFlmMr:t:", long_options,
+                            NULL)) != -1) {
+        switch (c) {
+        case 'F':
+            config.floating = true;
+            break;
+        case 'm':
+            config.coalesce_pointer_motion = true;
+            break;
+        case 'M':
+            config.coalesce_pointer_motion = true;
+            config.cap_pointer_motion_to_refresh = true;
+            break;
+        case 'r':
+            if (strcmp(optarg, "adaptive") == 0) {
+                config.max_render_time_msec = NORA_MAX_RENDER_TIME_ADAPTIVE;
+            } else {
+                config.max_render_time_msec = atoi(optarg);
+                if (config.max_render_time_msec < 0) {
+                    config.max_render_time_msec = 0;
+                }
+            }
+            break;
+        case 'l':
+            config.track_input_latency = true;
+            break;
+        case 't':
+            config.trace = true;
+            config.trace_path = optarg;
+            break;
+        case 'h':
+            printf("%s", usage);
+            return 0;
+        default:
+            fprintf(stderr, "%s", usage);
+            return 1;
+        }
+    }
+
     struct nora_server *server = nora_server_create(config);
 
     if (!nora_server_run(server)) {
@@ -1,26 +1,200 @@
+#include "input.h"
 #include "output.h"
 #include "server.h"
+#include "trace.h"
+#include "view.h"
 #include "wlr/util/log.h"
+#include <inttypes.h>
 #include <math.h>
 #include <stdlib.h>
 #include <wayland-util.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_layer_shell_v1.h>
 
-static void output_frame(struct wl_listener *listener, void *data) {
-  /* This function is called every time an output is ready to display a frame,
-   * generally at the output's refresh rate (e.g. 60Hz). */
-  struct nora_output *output = wl_container_of(listener, output, frame);
-  struct wlr_scene *scene =
-      nora_tree_root_present_scene(output->server->tree_root);
+static int64_t timespec_to_nsec(const struct timespec *ts) {
+  return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
 
-  struct wlr_scene_output *scene_output =
-      wlr_scene_get_scene_output(scene, output->wlr_output);
+static int64_t output_render_budget_nsec(struct nora_output *output) {
+  int32_t max_render_time = output->server->config.max_render_time_msec;
+  if (max_render_time > 0) {
+    return (int64_t)max_render_time * 1000000;
+  }
+
+  /* Adaptive, take the slowest of the recent frames plus some slack for the
+   * timer waking us up late. */
+  int64_t slowest = 0;
+  for (size_t i = 0; i < NORA_OUTPUT_RENDER_SAMPLES; ++i) {
+    if (output->schedule.render_nsec[i] > slowest) {
+      slowest = output->schedule.render_nsec[i];
+    }
+  }
+
+  return slowest > 0 ? slowest + 1000000 : 0;
+}
+
+static uint32_t output_frame_delay_msec(struct nora_output *output,
+                                        int64_t now) {
+  output->schedule.target_nsec = 0;
+
+  int64_t refresh = output->schedule.refresh_nsec;
+  int64_t last_present = output->schedule.last_present_nsec;
+  if (output->server->config.max_render_time_msec == 0 || refresh <= 0 ||
+      last_present == 0) {
+    return 0;
+  }
+
+  /* Predict the next vblank from the last presentation. */
+  int64_t next = last_present + ((now - last_present) / refresh + 1) * refresh;
+  output->schedule.target_nsec = next;
+
+  int64_t budget = output_render_budget_nsec(output);
+  if (budget <= 0) {
+    return 0;
+  }
+
+  int64_t delay = next - budget - now;
+  return delay >= 1000000 ? delay / 1000000 : 0;
+}
+
+static void output_render(struct nora_output *output) {
+  NORA_TRACE_FUNC();
+  struct nora_frame_timing *timing =
+      nora_frame_timings_last(&output->timings);
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (timing != NULL) {
+    timing->render_start_nsec = timespec_to_nsec(&start);
+    timing->target_nsec = output->schedule.target_nsec;
+  }
+
+  nora_input_output_frame(output);
+  nora_desktop_manager_unstable_v1_flush(output->server->desktop.manager);
+  nora_tree_output_prepare_present(output->tree_output);
+
+  struct wlr_scene_output *scene_output = output->scene_output;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (timing != NULL) {
+    timing->render_end_nsec = timespec_to_nsec(&start);
+  }
 
   /* Render the scene if needed and commit the output */
   wlr_scene_output_commit(scene_output, NULL);
 
   struct timespec now;
   clock_gettime(CLOCK_MONOTONIC, &now);
+
+  if (timing != NULL) {
+    timing->commit_nsec = timespec_to_nsec(&now);
+  }
+
+  output->schedule.render_nsec[output->schedule.render_sample] =
+      timespec_to_nsec(&now) - timespec_to_nsec(&start);
+  output->schedule.render_sample =
+      (output->schedule.render_sample + 1) % NORA_OUTPUT_RENDER_SAMPLES;
+
   wlr_scene_output_send_frame_done(scene_output, &now);
+  nora_layout_transaction_send_frame_done(&output->tree_output->transaction,
+                                          &now);
+}
+
+static int output_handle_render_timer(void *data) {
+  struct nora_output *output = data;
+  output_render(output);
+  return 0;
+}
+
+static void output_frame(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
+  /* This function is called every time an output is ready to display a frame,
+   * generally at the output's refresh rate (e.g. 60Hz). That is right after
+   * the previous vblank, so unless rendering is slow we wait until just
+   * before the next one to pick up the latest client updates. */
+  struct nora_output *output = wl_container_of(listener, output, frame);
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  nora_frame_timings_begin(&output->timings, timespec_to_nsec(&now));
+
+  uint32_t delay = output_frame_delay_msec(output, timespec_to_nsec(&now));
+  output->schedule.delay_msec = delay;
+
+  if (delay == 0 || output->render_timer == NULL) {
+    output_render(output);
+    return;
+  }
+
+  wl_event_source_timer_update(output->render_timer, delay);
+}
+
+static void output_present(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
+  struct nora_output *output = wl_container_of(listener, output, present);
+  const struct wlr_output_event_present *event = data;
+  if (!event->presented || event->when == NULL) {
+    return;
+  }
+
+  int64_t when = timespec_to_nsec(event->when);
+  int64_t target = output->schedule.target_nsec;
+  if (target != 0 && event->refresh > 0 && when > target + event->refresh / 2) {
+    output->schedule.missed_deadlines++;
+    wlr_log(WLR_DEBUG, "Output (%s) missed its deadline by %" PRId64 "us",
+            output->wlr_output->name, (when - target) / 1000);
+  }
+
+  /* Frames without damage are never committed and get no feedback, so this
+   * can only be the most recent committed frame. */
+  struct nora_frame_timing *timing = nora_frame_timings_last(&output->timings);
+  if (timing != NULL && timing->commit_nsec != 0 && timing->present_nsec == 0) {
+    timing->present_nsec = when;
+  }
+
+  nora_input_latency_present(&output->input_latency, when);
+
+  output->schedule.target_nsec = 0;
+  output->schedule.last_present_nsec = when;
+  output->schedule.refresh_nsec = event->refresh;
+}
+
+static void output_commit(struct wl_listener *listener, void *data) {
+  struct nora_output *output = wl_container_of(listener, output, commit);
+  const struct wlr_output_event_commit *event = data;
+
+  /* The layout box of the output changed, so did the area of its layer
+   * surfaces. */
+  if (output->tree_output != NULL &&
+      (event->state->committed &
+       (WLR_OUTPUT_STATE_MODE | WLR_OUTPUT_STATE_SCALE |
+        WLR_OUTPUT_STATE_TRANSFORM))) {
+    nora_arrange_layers(output);
+  }
+
+  if (!(event->state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+    return;
+  }
+
+  /* Only frames with damage get a new buffer, the input tagged so far is
+   * shown by this one. */
+  nora_input_latency_commit(&output->input_latency);
+
+  /* The scene only hands client buffers to the output when it scans out
+   * directly, composited frames come from the output's swapchain. */
+  bool direct_scanout = wlr_client_buffer_get(event->state->buffer) != NULL;
+  if (direct_scanout) {
+    output->stats.direct_scanout_frames++;
+  } else {
+    output->stats.composited_frames++;
+  }
+
+  if (direct_scanout != output->stats.direct_scanout) {
+    wlr_log(WLR_DEBUG, "Output (%s) %s direct scanout",
+            output->wlr_output->name,
+            direct_scanout ? "entered" : "left");
+    output->stats.direct_scanout = direct_scanout;
+  }
 }
 
 static void output_request_state(struct wl_listener *listener, void *data) {
@@ -35,7 +209,37 @@ static void output_request_state(struct wl_listener *listener, void *data) {
 static void output_destroy(struct wl_listener *listener, void *data) {
   struct nora_output *output = wl_container_of(listener, output, destroy);
 
+  wlr_log(WLR_INFO,
+          "Output (%s): %" PRIu64 " frames scanned out directly, %" PRIu64
+          " composited",
+          output->wlr_output->name, output->stats.direct_scanout_frames,
+          output->stats.composited_frames);
+  wlr_log(WLR_INFO,
+          "Output (%s): last frame delayed by %" PRIu32 "ms, %" PRIu64
+          " missed deadlines",
+          output->wlr_output->name, output->schedule.delay_msec,
+          output->schedule.missed_deadlines);
+  nora_frame_timings_dump(&output->timings, output->wlr_output->name);
+  if (output->server->config.track_input_latency) {
+    nora_input_latency_dump(&output->input_latency, output->wlr_output->name);
+  }
+
+  if (output->render_timer != NULL) {
+    wl_event_source_remove(output->render_timer);
+  }
+
+  /* Layer surfaces are bound to their output and go away with it, everything
+   * else moves to another output. */
+  struct nora_tree_container *container, *tmp;
+  wl_list_for_each_safe(container, tmp, &output->tree_output->containers,
+                        link) {
+    wlr_layer_surface_v1_destroy(container->view->layer.surface);
+  }
+  nora_tree_root_detach_output(output->server->tree_root, output->tree_output);
+
   wl_list_remove(&output->frame.link);
+  wl_list_remove(&output->commit.link);
+  wl_list_remove(&output->present.link);
   wl_list_remove(&output->request_state.link);
   wl_list_remove(&output->destroy.link);
   wl_list_remove(&output->link);
@@ -88,6 +292,20 @@ void nora_new_output(struct wl_listener *listener, void *data) {
   output->frame.notify = output_frame;
   wl_signal_add(&wlr_output->events.frame, &output->frame);
 
+  /* Sets up a listener for the commit event, used to tell direct scanout
+   * from composited frames. */
+  output->commit.notify = output_commit;
+  wl_signal_add(&wlr_output->events.commit, &output->commit);
+
+  /* Sets up a listener for the present event, feeding the frame scheduler
+   * with vblank timestamps. */
+  output->present.notify = output_present;
+  wl_signal_add(&wlr_output->events.present, &output->present);
+
+  output->render_timer = wl_event_loop_add_timer(
+      wl_display_get_event_loop(server->wl_display), output_handle_render_timer,
+      output);
+
   /* Sets up a listener for the state request event. */
   output->request_state.notify = output_request_state;
   wl_signal_add(&wlr_output->events.request_state, &output->request_state);
@@ -114,28 +332,26 @@ void nora_new_output(struct wl_listener *listener, void *data) {
 
   wlr_scene_output_layout_add_output(server->tree_root->scene_output_layout,
                                      l_output, scene_output);
+  output->scene_output = scene_output;
 
-  nora_tree_root_attach_output(output->server->tree_root, output);
+  output->tree_output =
+      nora_tree_root_attach_output(output->server->tree_root, output);
 }
 
-// TODO: Use cursor to determine current output.
 struct nora_output *nora_get_current_output(struct nora_server *server) {
   struct nora_output *output = NULL;
 
-  double lx = server->input.seat->pointer_state.sx;
-  double ly = server->input.seat->pointer_state.sy;
-
-  // if we are unable to get pointer coordinates for some reason just return the
-  // first output.
-  if (isnan(lx) || isnan(ly)) {
-    wl_list_for_each(output, &server->desktop.outputs, link) { return output; }
-  }
+  double lx = server->input.cursor->x;
+  double ly = server->input.cursor->y;
 
   struct wlr_output *wlr_output =
       wlr_output_layout_output_at(server->desktop.output_layout, lx, ly);
+
+  // if the cursor is not on any output for some reason just return the first
+  // output.
   if (!wlr_output) {
-    wlr_log(WLR_ERROR, "No output at (%lf, %lf)", lx, ly);
-    exit(EXIT_FAILURE);
+    wl_list_for_each(output, &server->desktop.outputs, link) { return output; }
+    return NULL;
   }
 
   wl_list_for_each(output, &server->desktop.outputs, link) {
@@ -158,3 +374,14 @@ struct nora_output *nora_output_of_wlr_output(struct nora_server *server,
 
   return output;
 }
+
+void nora_output_usable_box(struct nora_output *output, struct wlr_box *box) {
+  wlr_output_layout_get_box(output->server->desktop.output_layout,
+                            output->wlr_output, box);
+
+  /* Keep clear of the space reserved by panels. */
+  box->x += output->excluded_margin.left;
+  box->y += output->excluded_margin.top;
+  box->width -= output->excluded_margin.left + output->excluded_margin.right;
+  box->height -= output->excluded_margin.top + output->excluded_margin.bottom;
+}
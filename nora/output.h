@@ -7,6 +7,8 @@
 struct nora_output *nora_get_current_output(struct nora_server *server);
 struct nora_output *nora_output_of_wlr_output(struct nora_server *server,
                                               struct wlr_output *wlr_output);
+// The layout box of the output minus the space reserved by layer surfaces.
+void nora_output_usable_box(struct nora_output *output, struct wlr_box *box);
 
 // listener;
 void nora_new_output(struct wl_listener *listener, void *data);
@@ -1,3 +1,5 @@
+#include <inttypes.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
@@ -8,10 +10,76 @@
 #include "server.h"
 #include "view.h"
 
+#include "trace.h"
 #include "tree.h"
 
+static int handle_sigusr1(int signal_number, void *data) {
+  struct nora_server *server = data;
+
+  wlr_log(WLR_INFO,
+          "Desktop manager: %" PRIu64 " suppressed title/app_id updates",
+          server->desktop.manager->stats.suppressed_updates);
+  nora_view_log_stats(server);
+
+  struct nora_output *output;
+  wl_list_for_each(output, &server->desktop.outputs, link) {
+    nora_frame_timings_dump(&output->timings, output->wlr_output->name);
+    if (server->config.track_input_latency) {
+      nora_input_latency_dump(&output->input_latency,
+                              output->wlr_output->name);
+    }
+  }
+
+  return 0;
+}
+
+static void stop_trace(struct nora_server *server) {
+  nora_trace_stop();
+
+  if (server->config.trace_path != NULL) {
+    nora_trace_write(server->config.trace_path);
+    return;
+  }
+
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/nora-%ld.trace.json", (long)getpid());
+  nora_trace_write(path);
+}
+
+static int handle_sigusr2(int signal_number, void *data) {
+  struct nora_server *server = data;
+
+  if (nora_trace_enabled) {
+    stop_trace(server);
+  } else {
+    nora_trace_start();
+  }
+
+  return 0;
+}
+
+static void handle_manager_update_pending(struct wl_listener *listener,
+                                          void *data) {
+  struct nora_server *server =
+      wl_container_of(listener, server, desktop.manager_update_pending);
+
+  /* Title and app_id changes go out with the next output frame, at most one
+   * per view and frame however often clients change them. */
+  if (wl_list_empty(&server->desktop.outputs)) {
+    nora_desktop_manager_unstable_v1_flush(server->desktop.manager);
+    return;
+  }
+
+  struct nora_output *output;
+  wl_list_for_each(output, &server->desktop.outputs, link) {
+    wlr_output_schedule_frame(output->wlr_output);
+  }
+}
+
 struct nora_server *nora_server_create(struct nora_server_config config) {
   struct nora_server *server = calloc(1, sizeof(struct nora_server));
+  server->config = config;
+  nora_slab_init(&server->view_slab, "view", sizeof(struct nora_view));
 
   wlr_log_init(WLR_DEBUG, NULL);
 
@@ -36,7 +104,20 @@ struct nora_server *nora_server_create(struct nora_server_config config) {
     return NULL;
   }
 
-  wlr_renderer_init_wl_display(server->renderer, server->wl_display);
+  wlr_renderer_init_wl_shm(server->renderer, server->wl_display);
+
+  /* Advertise dmabuf support with the renderer's formats as default
+   * feedback. The scene uses the global to send per-surface feedback with
+   * scanout tranches, letting e.g. fullscreen clients allocate buffers the
+   * display can scan out directly. Renderers without dmabuf support (pixman)
+   * only get shm. */
+  if (wlr_renderer_get_dmabuf_texture_formats(server->renderer) != NULL) {
+    server->linux_dmabuf_v1 = wlr_linux_dmabuf_v1_create_with_renderer(
+        server->wl_display, 4, server->renderer);
+    if (server->linux_dmabuf_v1 == NULL) {
+      wlr_log(WLR_ERROR, "failed to create linux_dmabuf_v1");
+    }
+  }
 
   /* Autocreates an allocator for us.
    * The allocator is the bridge between the renderer and the backend. It
@@ -97,6 +178,23 @@ struct nora_server *nora_server_create(struct nora_server_config config) {
 
   server->desktop.manager =
       nora_desktop_manager_unstable_v1_create(server->wl_display);
+  server->desktop.manager_update_pending.notify = handle_manager_update_pending;
+  wl_signal_add(&server->desktop.manager->events.update_pending,
+                &server->desktop.manager_update_pending);
+
+  /* Frame timings of every output are logged on SIGUSR1, for looking into
+   * frame drops without a profiler. */
+  server->sigusr1_source = wl_event_loop_add_signal(
+      wl_display_get_event_loop(server->wl_display), SIGUSR1, handle_sigusr1,
+      server);
+
+  /* SIGUSR2 starts and stops tracing the compositor's hot paths. */
+  server->sigusr2_source = wl_event_loop_add_signal(
+      wl_display_get_event_loop(server->wl_display), SIGUSR2, handle_sigusr2,
+      server);
+  if (config.trace) {
+    nora_trace_start();
+  }
 
   /* Input
    */
@@ -127,6 +225,12 @@ struct nora_server *nora_server_create(struct nora_server_config config) {
                 &server->input.cursor_frame);
 
   wl_list_init(&server->input.keyboards);
+  nora_bindings_init(&server->input.bindings);
+  nora_bindings_add_defaults(&server->input.bindings);
+  nora_bindings_compile(&server->input.bindings);
+
+  wl_list_init(&server->input.keymaps);
+  server->input.xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
   server->input.new_input.notify = nora_new_input;
 
   wl_signal_add(&server->backend->events.new_input, &server->input.new_input);
@@ -168,10 +272,34 @@ int nora_server_run(struct nora_server *server) {
 }
 
 int nora_server_destroy(struct nora_server *server) {
+  wlr_log(WLR_INFO, "Pointer motion: %" PRIu64 " events, %" PRIu64 " hit-tests",
+          server->input.stats.motion_events,
+          server->input.stats.motion_hit_tests);
+  wlr_log(WLR_INFO,
+          "Desktop manager: %" PRIu64 " suppressed title/app_id updates",
+          server->desktop.manager->stats.suppressed_updates);
+
+  if (nora_trace_enabled) {
+    stop_trace(server);
+  }
+
+  if (server->sigusr1_source != NULL) {
+    wl_event_source_remove(server->sigusr1_source);
+  }
+  if (server->sigusr2_source != NULL) {
+    wl_event_source_remove(server->sigusr2_source);
+  }
+
   wl_display_destroy_clients(server->wl_display);
   wlr_xcursor_manager_destroy(server->input.cursor_mgr);
   wlr_output_layout_destroy(server->desktop.output_layout);
   wl_display_destroy(server->wl_display);
+  nora_input_destroy_keymaps(server);
+  nora_bindings_finish(&server->input.bindings);
+
+  nora_view_log_stats(server);
+  nora_slab_finish(&server->view_slab);
+  nora_slab_finish(&server->tree_root->container_slab);
 
   free(server);
   return 0;
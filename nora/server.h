@@ -35,6 +35,9 @@
 
 #include "desktop/manager.h"
 
+#include "bindings.h"
+#include "slab.h"
+#include "timings.h"
 #include "tree.h"
 
 #define UNREACHABLE()                                                          \
@@ -47,9 +50,33 @@ enum nora_cursor_mode {
   NORA_CURSOR_RESIZE,
 };
 
-struct nora_server_config {};
+struct nora_server_config {
+  // Only resolve pointer focus and send motion to clients once per pointer
+  // frame instead of on every motion event.
+  bool coalesce_pointer_motion;
+  // When coalescing, additionally resolve pointer focus at most once per frame
+  // of the output under the cursor.
+  bool cap_pointer_motion_to_refresh;
+  // Time in milliseconds reserved for rendering before the predicted vblank,
+  // rendering is delayed until then. 0 renders as soon as the output asks for
+  // a frame, NORA_MAX_RENDER_TIME_ADAPTIVE estimates it from past frames.
+  int32_t max_render_time_msec;
+  // Measure the latency from input events to the presentation of the first
+  // frame after them, per output.
+  bool track_input_latency;
+  // Trace from startup on. The trace is written to trace_path, or a file
+  // named after the pid in /tmp if NULL, whenever tracing stops.
+  bool trace;
+  const char *trace_path;
+  // Let views float freely instead of tiling them.
+  bool floating;
+};
+
+#define NORA_MAX_RENDER_TIME_ADAPTIVE -1
 
 struct nora_server {
+  struct nora_server_config config;
+
   struct wl_display *wl_display;
   struct wlr_backend *backend;
   struct wlr_renderer *renderer;
@@ -60,6 +87,18 @@ struct nora_server {
   struct wlr_linux_dmabuf_v1 *linux_dmabuf_v1;
 
   struct nora_tree_root *tree_root;
+  // Every nora_view is allocated from here.
+  struct nora_slab view_slab;
+  // Views created and not destroyed yet, per kind. Anything left once the
+  // clients are gone has leaked.
+  struct {
+    size_t toplevels;
+    size_t popups;
+    size_t layers;
+  } live_views;
+
+  struct wl_event_source *sigusr1_source;
+  struct wl_event_source *sigusr2_source;
 
   struct {
     struct wlr_seat *seat;
@@ -78,6 +117,15 @@ struct nora_server {
 
     struct wl_list keyboards;
 
+    struct nora_bindings bindings;
+
+    /* Compiled keymaps shared by all keyboards, keyed by their RMLVO names.
+     * Keyboards sharing a keymap let the seat switch between them without
+     * sending a new keymap to clients.
+     */
+    struct xkb_context *xkb_context;
+    struct wl_list keymaps; // nora_keymap::link
+
     /* Grabs (resizing, moving etc)
      */
     enum nora_cursor_mode cursor_mode;
@@ -85,6 +133,19 @@ struct nora_server {
     double grab_x, grab_y;
     struct wlr_box grab_geobox;
     uint32_t resize_edges;
+
+    /* Pointer motion coalescing
+     */
+    bool motion_pending;
+    uint32_t motion_time_msec;
+    // Set once pointer focus was resolved during the current frame of the
+    // output under the cursor.
+    bool motion_processed_this_frame;
+
+    struct {
+      uint64_t motion_events;
+      uint64_t motion_hit_tests;
+    } stats;
   } input;
 
   struct {
@@ -102,19 +163,54 @@ struct nora_server {
 
     struct wl_listener new_layer_surface;
 
+    struct wl_listener manager_update_pending;
+
     struct wl_listener new_output;
   } desktop;
 };
 
+#define NORA_OUTPUT_RENDER_SAMPLES 16
+
 struct nora_output {
   struct wl_list link;
 
   struct nora_server *server;
   struct wlr_output *wlr_output;
+  struct wlr_scene_output *scene_output;
+  struct nora_tree_output *tree_output;
+
   struct wl_listener frame;
+  struct wl_listener commit;
+  struct wl_listener present;
   struct wl_listener request_state;
   struct wl_listener destroy;
 
+  // Frame scheduling, see nora_server_config::max_render_time_msec.
+  struct wl_event_source *render_timer;
+  struct {
+    int64_t last_present_nsec;
+    int64_t refresh_nsec;
+    // vblank the last rendered frame was aimed at, 0 if unknown.
+    int64_t target_nsec;
+    int64_t render_nsec[NORA_OUTPUT_RENDER_SAMPLES];
+    size_t render_sample;
+
+    uint32_t delay_msec;
+    uint64_t missed_deadlines;
+  } schedule;
+
+  // Dumped on SIGUSR1.
+  struct nora_frame_timings timings;
+  struct nora_input_latency input_latency;
+
+  struct {
+    // Frames where a client buffer was handed to the display as-is, versus
+    // frames the renderer had to composite.
+    uint64_t direct_scanout_frames;
+    uint64_t composited_frames;
+    bool direct_scanout;
+  } stats;
+
   struct {
     uint32_t left;
     uint32_t right;
@@ -123,11 +219,37 @@ struct nora_output {
   } excluded_margin;
 };
 
+struct nora_keymap {
+  struct wl_list link; // nora_server::input.keymaps
+
+  char *rules;
+  char *model;
+  char *layout;
+  char *variant;
+  char *options;
+
+  struct xkb_keymap *keymap;
+};
+
+struct nora_held_key {
+  uint32_t keycode;
+  const struct nora_binding *binding;
+};
+
 struct nora_keyboard {
   struct wl_list link;
   struct nora_server *server;
   struct wlr_keyboard *wlr_keyboard;
 
+  /* Keys which triggered a binding, their release never reaches clients. The
+   * array keeps its capacity, so only the first presses ever allocate.
+   */
+  struct wl_array held; // nora_held_key
+
+  struct wl_event_source *repeat_source;
+  const struct nora_binding *repeat_binding;
+  uint32_t repeat_keycode;
+
   struct wl_listener modifiers;
   struct wl_listener key;
   struct wl_listener destroy;
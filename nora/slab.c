@@ -0,0 +1,133 @@
+#include <inttypes.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <wlr/util/log.h>
+
+#include "slab.h"
+
+/* Under AddressSanitizer every object comes straight from calloc, so a use
+ * after nora_slab_free() or a leaked object is still reported instead of
+ * hiding in a page. */
+#if defined(__SANITIZE_ADDRESS__)
+#define NORA_SLAB_PASSTHROUGH 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define NORA_SLAB_PASSTHROUGH 1
+#endif
+#endif
+
+struct nora_slab_page {
+  struct wl_list link; // nora_slab::pages
+  alignas(max_align_t) unsigned char objects[];
+};
+
+void nora_slab_init(struct nora_slab *slab, const char *name,
+                    size_t object_size) {
+  memset(slab, 0, sizeof(*slab));
+  slab->name = name;
+
+  // Keep every object of a page aligned like malloc would.
+  size_t align = alignof(max_align_t);
+  if (object_size < sizeof(void *)) {
+    object_size = sizeof(void *);
+  }
+  slab->object_size = (object_size + align - 1) / align * align;
+
+  wl_list_init(&slab->pages);
+}
+
+void nora_slab_finish(struct nora_slab *slab) {
+  if (slab->stats.in_use > 0) {
+    wlr_log(WLR_ERROR, "Slab (%s): %zu objects still in use", slab->name,
+            slab->stats.in_use);
+  }
+
+  struct nora_slab_page *page, *tmp;
+  wl_list_for_each_safe(page, tmp, &slab->pages, link) {
+    wl_list_remove(&page->link);
+    free(page);
+  }
+
+  slab->free_list = NULL;
+  slab->stats.pages = 0;
+}
+
+#ifndef NORA_SLAB_PASSTHROUGH
+static bool nora_slab_grow(struct nora_slab *slab) {
+  struct nora_slab_page *page = malloc(
+      sizeof(*page) + slab->object_size * NORA_SLAB_PAGE_OBJECTS);
+  if (page == NULL) {
+    return false;
+  }
+
+  wl_list_insert(&slab->pages, &page->link);
+  slab->stats.pages++;
+
+  // Thread the objects onto the free list so the first one is handed out
+  // first.
+  for (size_t i = NORA_SLAB_PAGE_OBJECTS; i-- > 0;) {
+    void *object = page->objects + i * slab->object_size;
+    *(void **)object = slab->free_list;
+    slab->free_list = object;
+  }
+
+  return true;
+}
+#endif
+
+void *nora_slab_alloc(struct nora_slab *slab) {
+#ifdef NORA_SLAB_PASSTHROUGH
+  void *object = calloc(1, slab->object_size);
+  if (object == NULL) {
+    wlr_log(WLR_ERROR, "Slab (%s): out of memory", slab->name);
+    return NULL;
+  }
+#else
+  if (slab->free_list == NULL && !nora_slab_grow(slab)) {
+    wlr_log(WLR_ERROR, "Slab (%s): out of memory", slab->name);
+    return NULL;
+  }
+
+  void *object = slab->free_list;
+  slab->free_list = *(void **)object;
+  memset(object, 0, slab->object_size);
+#endif
+
+  slab->stats.allocs++;
+  if (++slab->stats.in_use > slab->stats.peak) {
+    slab->stats.peak = slab->stats.in_use;
+  }
+
+  return object;
+}
+
+void nora_slab_free(struct nora_slab *slab, void *object) {
+  if (object == NULL) {
+    return;
+  }
+
+#ifdef NORA_SLAB_PASSTHROUGH
+  free(object);
+#else
+  *(void **)object = slab->free_list;
+  slab->free_list = object;
+#endif
+
+  slab->stats.frees++;
+  slab->stats.in_use--;
+}
+
+void nora_slab_log_stats(const struct nora_slab *slab) {
+  size_t capacity = slab->stats.pages * NORA_SLAB_PAGE_OBJECTS;
+  wlr_log(WLR_INFO,
+          "Slab (%s): %zu/%zu objects in use (%.0f%%), peak %zu, %zu pages "
+          "of %zu bytes, %" PRIu64 " allocs, %" PRIu64 " frees",
+          slab->name, slab->stats.in_use, capacity,
+          capacity > 0 ? slab->stats.in_use * 100.0 / capacity : 0.0,
+          slab->stats.peak, slab->stats.pages,
+          slab->object_size * NORA_SLAB_PAGE_OBJECTS, slab->stats.allocs,
+          slab->stats.frees);
+}
@@ -0,0 +1,45 @@
+#ifndef NORA_SLAB_H_
+#define NORA_SLAB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <wayland-util.h>
+
+// Objects per page, pages are allocated as a whole and kept until the pool
+// is finished.
+#define NORA_SLAB_PAGE_OBJECTS 64
+
+/* A pool of fixed-size objects for structs created and destroyed at high
+ * rates, e.g. the view and container of every popup. Objects come from pages
+ * of NORA_SLAB_PAGE_OBJECTS and freed objects are reused first, so churn never
+ * reaches malloc and objects of one kind stay close together in memory.
+ * AddressSanitizer builds bypass the pages and use calloc and free. */
+struct nora_slab {
+  const char *name;
+  size_t object_size;
+
+  struct wl_list pages; // nora_slab_page::link
+  void *free_list;      // freed objects, linked through their first bytes
+
+  struct {
+    size_t in_use;
+    size_t peak;
+    size_t pages;
+    uint64_t allocs;
+    uint64_t frees;
+  } stats;
+};
+
+void nora_slab_init(struct nora_slab *slab, const char *name,
+                    size_t object_size);
+// Every object must have been freed.
+void nora_slab_finish(struct nora_slab *slab);
+
+// Returns a zeroed object or NULL if out of memory.
+void *nora_slab_alloc(struct nora_slab *slab);
+void nora_slab_free(struct nora_slab *slab, void *object);
+
+void nora_slab_log_stats(const struct nora_slab *slab);
+
+#endif // NORA_SLAB_H_
@@ -0,0 +1,137 @@
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <wlr/util/log.h>
+
+#include "timings.h"
+
+struct nora_frame_timing *
+nora_frame_timings_begin(struct nora_frame_timings *timings,
+                         int64_t frame_nsec) {
+  struct nora_frame_timing *timing = &timings->frames[timings->head];
+  *timing = (struct nora_frame_timing){.frame_nsec = frame_nsec};
+
+  timings->head = (timings->head + 1) % NORA_FRAME_TIMINGS_MAX;
+  if (timings->count < NORA_FRAME_TIMINGS_MAX) {
+    timings->count++;
+  }
+
+  return timing;
+}
+
+struct nora_frame_timing *
+nora_frame_timings_last(struct nora_frame_timings *timings) {
+  if (timings->count == 0) {
+    return NULL;
+  }
+
+  size_t last = (timings->head + NORA_FRAME_TIMINGS_MAX - 1) %
+                NORA_FRAME_TIMINGS_MAX;
+  return &timings->frames[last];
+}
+
+static int compare_int64(const void *a, const void *b) {
+  int64_t x = *(const int64_t *)a;
+  int64_t y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static int64_t percentile(const int64_t *sorted, size_t count, int p) {
+  return sorted[(count - 1) * p / 100];
+}
+
+static void log_percentiles(const char *name, const char *stage,
+                            int64_t *samples, size_t count) {
+  if (count == 0) {
+    wlr_log(WLR_INFO, "Output (%s) %-8s: no samples", name, stage);
+    return;
+  }
+
+  qsort(samples, count, sizeof(*samples), compare_int64);
+
+  wlr_log(WLR_INFO,
+          "Output (%s) %-8s: p50 %" PRId64 "us, p90 %" PRId64
+          "us, p99 %" PRId64 "us, max %" PRId64 "us (%zu frames)",
+          name, stage, percentile(samples, count, 50) / 1000,
+          percentile(samples, count, 90) / 1000,
+          percentile(samples, count, 99) / 1000, samples[count - 1] / 1000,
+          count);
+}
+
+// Logs the distribution of end - start in microseconds over the frames where
+// both stages happened.
+static void dump_stage(const struct nora_frame_timings *timings,
+                       const char *name, const char *stage,
+                       size_t start_offset, size_t end_offset) {
+  int64_t samples[NORA_FRAME_TIMINGS_MAX];
+  size_t count = 0;
+
+  for (size_t i = 0; i < timings->count; ++i) {
+    const char *frame = (const char *)&timings->frames[i];
+    int64_t start, end;
+    memcpy(&start, frame + start_offset, sizeof(start));
+    memcpy(&end, frame + end_offset, sizeof(end));
+    if (start == 0 || end == 0) {
+      continue;
+    }
+
+    samples[count++] = end - start;
+  }
+
+  log_percentiles(name, stage, samples, count);
+}
+
+void nora_frame_timings_dump(const struct nora_frame_timings *timings,
+                             const char *name) {
+#define STAGE(stage, start, end)                                               \
+  dump_stage(timings, name, stage, offsetof(struct nora_frame_timing, start),  \
+             offsetof(struct nora_frame_timing, end))
+
+  STAGE("delay", frame_nsec, render_start_nsec);
+  STAGE("prepare", render_start_nsec, render_end_nsec);
+  STAGE("commit", render_end_nsec, commit_nsec);
+  STAGE("present", commit_nsec, present_nsec);
+  // Positive when the frame landed after the vblank it was scheduled for.
+  STAGE("late", target_nsec, present_nsec);
+
+#undef STAGE
+}
+
+void nora_input_latency_tag(struct nora_input_latency *latency,
+                            int64_t input_nsec) {
+  if (latency->pending_nsec == 0) {
+    latency->pending_nsec = input_nsec;
+  }
+}
+
+void nora_input_latency_commit(struct nora_input_latency *latency) {
+  // An older input still waiting for presentation keeps its place, the frame
+  // it went out with was not presented yet.
+  if (latency->inflight_nsec == 0) {
+    latency->inflight_nsec = latency->pending_nsec;
+    latency->pending_nsec = 0;
+  }
+}
+
+void nora_input_latency_present(struct nora_input_latency *latency,
+                                int64_t present_nsec) {
+  if (latency->inflight_nsec == 0) {
+    return;
+  }
+
+  latency->samples[latency->head] = present_nsec - latency->inflight_nsec;
+  latency->head = (latency->head + 1) % NORA_INPUT_LATENCY_SAMPLES;
+  if (latency->count < NORA_INPUT_LATENCY_SAMPLES) {
+    latency->count++;
+  }
+
+  latency->inflight_nsec = 0;
+}
+
+void nora_input_latency_dump(const struct nora_input_latency *latency,
+                             const char *name) {
+  int64_t samples[NORA_INPUT_LATENCY_SAMPLES];
+  memcpy(samples, latency->samples, latency->count * sizeof(*samples));
+  log_percentiles(name, "input", samples, latency->count);
+}
@@ -0,0 +1,68 @@
+#ifndef NORA_TIMINGS_H_
+#define NORA_TIMINGS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NORA_FRAME_TIMINGS_MAX 256
+
+// Timestamps of one output frame, in CLOCK_MONOTONIC nanoseconds. Stages that
+// did not happen (yet) are 0.
+struct nora_frame_timing {
+  // The output asked for a frame.
+  int64_t frame_nsec;
+  // Rendering started, after the scheduling delay.
+  int64_t render_start_nsec;
+  // The scene was prepared and flushed, the renderer is up next.
+  int64_t render_end_nsec;
+  // wlr_scene_output_commit returned.
+  int64_t commit_nsec;
+  // The vblank the frame was scheduled for and the one it actually hit.
+  int64_t target_nsec;
+  int64_t present_nsec;
+};
+
+// Fixed-size ring buffer of the most recent frames of an output. Recording
+// never allocates.
+struct nora_frame_timings {
+  struct nora_frame_timing frames[NORA_FRAME_TIMINGS_MAX];
+  size_t head; // next slot to be written
+  size_t count;
+};
+
+// Starts a new frame, overwriting the oldest one once the ring is full.
+struct nora_frame_timing *
+nora_frame_timings_begin(struct nora_frame_timings *timings,
+                         int64_t frame_nsec);
+// Returns the most recent frame, NULL if none was recorded yet.
+struct nora_frame_timing *
+nora_frame_timings_last(struct nora_frame_timings *timings);
+
+// Logs percentiles of every stage over the recorded frames.
+void nora_frame_timings_dump(const struct nora_frame_timings *timings,
+                             const char *name);
+
+#define NORA_INPUT_LATENCY_SAMPLES 256
+
+// Input-to-present latency of an output. The first input event after a
+// presented frame is tagged, the next frame with damage carries it and its
+// presentation feedback closes the sample.
+struct nora_input_latency {
+  int64_t pending_nsec;  // tagged, not committed yet
+  int64_t inflight_nsec; // committed, waiting for presentation
+
+  int64_t samples[NORA_INPUT_LATENCY_SAMPLES];
+  size_t head; // next slot to be written
+  size_t count;
+};
+
+void nora_input_latency_tag(struct nora_input_latency *latency,
+                            int64_t input_nsec);
+void nora_input_latency_commit(struct nora_input_latency *latency);
+void nora_input_latency_present(struct nora_input_latency *latency,
+                                int64_t present_nsec);
+
+void nora_input_latency_dump(const struct nora_input_latency *latency,
+                             const char *name);
+
+#endif // NORA_TIMINGS_H_
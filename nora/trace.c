@@ -0,0 +1,133 @@
+#define _GNU_SOURCE
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <wlr/util/log.h>
+
+#include "trace.h"
+
+#define NORA_TRACE_EVENTS_MAX 16384
+
+struct nora_trace_event {
+  int64_t time_nsec;
+  const char *name;
+  char phase;
+};
+
+struct nora_trace_buffer {
+  struct nora_trace_buffer *next;
+  long tid;
+
+  size_t head; // next slot to be written
+  size_t count;
+  struct nora_trace_event events[NORA_TRACE_EVENTS_MAX];
+};
+
+bool nora_trace_enabled = false;
+
+// Every thread records into its own buffer, so recording takes no lock. The
+// buffers are published once on a lock-free list for nora_trace_write and
+// live until the process exits.
+static _Thread_local struct nora_trace_buffer *thread_buffer = NULL;
+static _Atomic(struct nora_trace_buffer *) buffers = NULL;
+
+static struct nora_trace_buffer *nora_trace_thread_buffer(void) {
+  if (thread_buffer != NULL) {
+    return thread_buffer;
+  }
+
+  struct nora_trace_buffer *buffer = calloc(1, sizeof(*buffer));
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  buffer->tid = syscall(SYS_gettid);
+  buffer->next = atomic_load(&buffers);
+  while (!atomic_compare_exchange_weak(&buffers, &buffer->next, buffer)) {
+  }
+
+  thread_buffer = buffer;
+  return buffer;
+}
+
+void nora_trace_record(const char *name, char phase) {
+  struct nora_trace_buffer *buffer = nora_trace_thread_buffer();
+  if (buffer == NULL) {
+    return;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  buffer->events[buffer->head] = (struct nora_trace_event){
+      .time_nsec = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec,
+      .name = name,
+      .phase = phase,
+  };
+
+  buffer->head = (buffer->head + 1) % NORA_TRACE_EVENTS_MAX;
+  if (buffer->count < NORA_TRACE_EVENTS_MAX) {
+    buffer->count++;
+  }
+}
+
+void nora_trace_start(void) {
+  // Start from a clean slate, so a trace only covers one session.
+  for (struct nora_trace_buffer *buffer = atomic_load(&buffers);
+       buffer != NULL; buffer = buffer->next) {
+    buffer->head = 0;
+    buffer->count = 0;
+  }
+
+  nora_trace_enabled = true;
+  wlr_log(WLR_INFO, "Tracing started");
+}
+
+void nora_trace_stop(void) {
+  nora_trace_enabled = false;
+  wlr_log(WLR_INFO, "Tracing stopped");
+}
+
+bool nora_trace_write(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    wlr_log_errno(WLR_ERROR, "failed to open trace file %s", path);
+    return false;
+  }
+
+  long pid = getpid();
+  bool first = true;
+
+  fprintf(file, "{\"traceEvents\":[\n");
+  for (struct nora_trace_buffer *buffer = atomic_load(&buffers);
+       buffer != NULL; buffer = buffer->next) {
+    size_t start = (buffer->head + NORA_TRACE_EVENTS_MAX - buffer->count) %
+                   NORA_TRACE_EVENTS_MAX;
+    for (size_t i = 0; i < buffer->count; ++i) {
+      const struct nora_trace_event *event =
+          &buffer->events[(start + i) % NORA_TRACE_EVENTS_MAX];
+
+      // Names are identifiers, nothing to escape.
+      fprintf(file,
+              "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%ld,"
+              "\"tid\":%ld}",
+              first ? "" : ",\n", event->name, event->phase,
+              event->time_nsec / 1000.0, pid, buffer->tid);
+      first = false;
+    }
+  }
+  fprintf(file, "\n]}\n");
+
+  if (fclose(file) != 0) {
+    wlr_log_errno(WLR_ERROR, "failed to write trace file %s", path);
+    return false;
+  }
+
+  wlr_log(WLR_INFO, "Trace written to %s", path);
+  return true;
+}
@@ -0,0 +1,44 @@
+#ifndef NORA_TRACE_H_
+#define NORA_TRACE_H_
+
+#include <stdbool.h>
+
+// Begin/end events of the compositor's hot paths, kept in a ring buffer per
+// thread and written out as Chrome trace JSON, which Perfetto and
+// chrome://tracing open directly.
+//
+// While tracing is stopped an instrumented scope costs a single branch on
+// nora_trace_enabled.
+
+extern bool nora_trace_enabled;
+
+void nora_trace_start(void);
+void nora_trace_stop(void);
+// Writes the events recorded by every thread, oldest first.
+bool nora_trace_write(const char *path);
+
+void nora_trace_record(const char *name, char phase);
+
+static inline const char *nora_trace_begin(const char *name) {
+  if (__builtin_expect(nora_trace_enabled, false)) {
+    nora_trace_record(name, 'B');
+  }
+  return name;
+}
+
+static inline void nora_trace_end(const char **name) {
+  if (__builtin_expect(nora_trace_enabled, false)) {
+    nora_trace_record(*name, 'E');
+  }
+}
+
+// Traces the enclosing scope, until it is left by any path. The name must be
+// a string literal or otherwise outlive the trace.
+#define NORA_TRACE_SCOPE(name)                                                 \
+  const char *nora_trace_scope_                                                \
+      __attribute__((cleanup(nora_trace_end), unused)) = nora_trace_begin(name)
+
+// Traces the enclosing function.
+#define NORA_TRACE_FUNC() NORA_TRACE_SCOPE(__func__)
+
+#endif // NORA_TRACE_H_
@@ -1,6 +1,10 @@
 #include <stdbool.h>
 
+#include <wlr/types/wlr_layer_shell_v1.h>
+
+#include "output.h"
 #include "server.h"
+#include "trace.h"
 #include "tree.h"
 #include "view.h"
 
@@ -8,88 +12,89 @@ bool nora_tree_container_is_ownable(struct nora_tree_container *container) {
   return container->ownable;
 }
 
-struct nora_tree_container *nora_tree_container_find_container_by_surface(
-    struct nora_tree_container *parent, struct wlr_surface *surface) {
-  struct nora_tree_container *container, *tmp;
-  wl_list_for_each_safe(container, tmp, &parent->children, link) {
-    if (container->surface == surface) {
-      return container;
-    }
-
-    return nora_tree_container_find_container_by_surface(container, surface);
-  }
-
-  return NULL;
-}
-
-struct nora_tree_container *nora_tree_workspace_find_container_by_surface(
-    struct nora_tree_workspace *workspace, struct wlr_surface *surface) {
-  struct nora_tree_container *container, *tmp;
-  wl_list_for_each_safe(container, tmp, &workspace->containers, link) {
-    if (container->surface == surface)
-      return container;
-  }
-
-  return NULL;
-}
-
 struct nora_tree_container *
-nora_tree_output_find_container_by_surface(struct nora_tree_output *output,
-                                           struct wlr_surface *surface) {
-  // For example, layer shells do not belong to a workspace but rather a output.
-  struct nora_tree_container *container, *tmp_container;
-  wl_list_for_each_safe(container, tmp_container, &output->containers, link) {
-    if (container->surface == surface) {
-      return container;
-    }
+nora_tree_root_find_container_by_surface(struct nora_tree_root *root,
+                                         struct wlr_surface *surface) {
+  NORA_TRACE_FUNC();
+  (void)root;
+
+  // Every container inserted into the tree stores itself in its surface's data
+  // field, so we never have to walk the tree to resolve a surface.
+  if (surface == NULL) {
+    return NULL;
   }
 
-  struct nora_tree_workspace *workspace, *tmp_workspace;
-  wl_list_for_each_safe(workspace, tmp_workspace, &output->workspaces, link) {
-    struct nora_tree_container *container =
-        nora_tree_workspace_find_container_by_surface(workspace, surface);
-    if (container != NULL) {
-      return container;
-    }
+  struct nora_tree_container *container = surface->data;
+  if (container == NULL || container->surface != surface) {
+    return NULL;
   }
 
-  return NULL;
+  return container;
 }
 
-struct nora_tree_container *
-nora_tree_root_find_container_by_surface(struct nora_tree_root *root,
-                                         struct wlr_surface *surface) {
-  struct nora_tree_output *output, *tmp;
-  wl_list_for_each_safe(output, tmp, &root->outputs, link) {
-    struct nora_tree_container *container =
-        nora_tree_output_find_container_by_surface(output, surface);
-    if (container != NULL) {
-      return container;
-    }
+static void nora_tree_container_index(struct nora_tree_container *container) {
+  if (container->surface != NULL) {
+    container->surface->data = container;
   }
-
-  return NULL;
 }
 
 void nora_tree_container_insert_child(struct nora_tree_container *parent,
                                       struct nora_tree_container *child) {
+  child->root = parent->root;
+  child->parent = parent;
+
   wl_list_insert(&parent->children, &child->link);
+  nora_tree_container_index(child);
 }
 
 void nora_tree_workspace_insert_container(
     struct nora_tree_workspace *workspace,
     struct nora_tree_container *container) {
+  container->root = workspace->output->root;
+  container->workspace = workspace;
+
   wl_list_insert(&workspace->containers, &container->link);
+  nora_tree_container_index(container);
 }
 
 struct nora_tree_workspace *
 nora_tree_output_current_workspace(struct nora_tree_output *output) {
-  struct nora_tree_workspace *workspace, *tmp;
-  wl_list_for_each_safe(workspace, tmp, &output->workspaces, link) {
-    return workspace;
+  return output->current_workspace;
+}
+
+struct nora_tree_workspace *
+nora_tree_output_workspace(struct nora_tree_output *output, uint32_t id) {
+  // Workspaces are kept sorted by id.
+  struct nora_tree_workspace *workspace;
+  wl_list_for_each(workspace, &output->workspaces, link) {
+    if (workspace->id == id) {
+      return workspace;
+    }
+
+    if (workspace->id > id) {
+      break;
+    }
   }
 
-  return NULL;
+  struct nora_tree_workspace *created =
+      nora_tree_workspace_create(output, id);
+  wl_list_insert(workspace->link.prev, &created->link);
+
+  // Hidden until it becomes the current workspace.
+  nora_tree_workspace_disable(created);
+
+  return created;
+}
+
+void nora_tree_output_set_current_workspace(
+    struct nora_tree_output *output, struct nora_tree_workspace *workspace) {
+  assert(workspace->output == output);
+  if (output->current_workspace == workspace) {
+    return;
+  }
+
+  output->current_workspace = workspace;
+  output->workspaces_dirty = true;
 }
 
 void nora_tree_output_insert_container(struct nora_tree_output *output,
@@ -103,7 +108,10 @@ void nora_tree_output_insert_container(struct nora_tree_output *output,
     return;
   }
 
+  container->root = output->root;
+
   wl_list_insert(&output->containers, &container->link);
+  nora_tree_container_index(container);
 }
 
 void nora_tree_workspace_disable(struct nora_tree_workspace *workspace) {
@@ -114,52 +122,402 @@ void nora_tree_workspace_enable(struct nora_tree_workspace *workspace) {
   wlr_scene_node_set_enabled(&workspace->scene_tree->node, true);
 }
 
+// Returns NULL for a popup whose scene tree went away with its parent's.
+static struct wlr_scene_node *
+nora_tree_container_scene_node(struct nora_tree_container *container) {
+  struct nora_view *view = container->view;
+  switch (view->kind) {
+  case NORA_VIEW_KIND_XDG_TOPLEVEL:
+    return &view->xdg_toplevel.scene_tree->node;
+  case NORA_VIEW_KIND_XDG_POPUP:
+    return view->xdg_popup.scene_tree != NULL
+               ? &view->xdg_popup.scene_tree->node
+               : NULL;
+  case NORA_VIEW_KIND_LAYER:
+    return &view->layer.scene_tree->tree->node;
+  }
+
+  UNREACHABLE();
+}
+
 void nora_tree_output_prepare_present(struct nora_tree_output *output) {
+  NORA_TRACE_FUNC();
+  // Workspace visibility only changes when the current workspace does, so the
+  // scene is left untouched on the frames in between.
+  if (!output->workspaces_dirty) {
+    return;
+  }
+
+  struct nora_tree_workspace *current = output->current_workspace;
+
   struct nora_tree_workspace *workspace, *tmp;
   wl_list_for_each_safe(workspace, tmp, &output->workspaces, link) {
-    if (workspace != nora_tree_output_current_workspace(output)) {
+    if (workspace->fullscreen != NULL) {
+      wlr_scene_node_set_enabled(
+          nora_tree_container_scene_node(workspace->fullscreen),
+          workspace == current);
+    }
+
+    if (workspace != current || workspace->fullscreen != NULL) {
       nora_tree_workspace_disable(workspace);
     } else {
       nora_tree_workspace_enable(workspace);
     }
+
+    // Views which are no longer shown are told to stop rendering.
+    struct nora_tree_container *container;
+    wl_list_for_each(container, &workspace->containers, link) {
+      nora_view_update_suspended(container->view);
+    }
+  }
+
+  /* A fullscreen view covers the whole output, the layers below the overlay
+   * are disabled with it so neither rendering nor hit-tests visit them. */
+  bool fullscreen = current != NULL && current->fullscreen != NULL;
+  wlr_scene_node_set_enabled(&output->fullscreen_tree->node, fullscreen);
+  wlr_scene_node_set_enabled(
+      &output->layers[ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND]->node, !fullscreen);
+  wlr_scene_node_set_enabled(
+      &output->layers[ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM]->node, !fullscreen);
+  wlr_scene_node_set_enabled(
+      &output->layers[ZWLR_LAYER_SHELL_V1_LAYER_TOP]->node, !fullscreen);
+
+  output->workspaces_dirty = false;
+}
+
+/* Popups of layer surfaces are drawn in the output's popups_tree, above
+ * everything else unlike their parent, so they are indexed on their own. */
+static bool
+nora_tree_container_is_layer_popup(struct nora_tree_container *container) {
+  return container->parent != NULL &&
+         container->view->kind == NORA_VIEW_KIND_XDG_POPUP &&
+         container->parent->view->kind == NORA_VIEW_KIND_LAYER;
+}
+
+// Returns the container whose index entry covers the given one.
+static struct nora_tree_container *
+nora_tree_container_index_root(struct nora_tree_container *container) {
+  while (container->parent != NULL &&
+         !nora_tree_container_is_layer_popup(container)) {
+    container = container->parent;
+  }
+
+  return container;
+}
+
+static enum nora_tree_band
+nora_tree_container_band(struct nora_tree_container *container) {
+  if (nora_tree_container_is_layer_popup(container)) {
+    return NORA_TREE_BAND_POPUP;
+  }
+
+  struct nora_view *view = container->view;
+  if (view->kind != NORA_VIEW_KIND_LAYER) {
+    if (container->workspace != NULL &&
+        container->workspace->fullscreen == container) {
+      return NORA_TREE_BAND_FULLSCREEN;
+    }
+
+    return NORA_TREE_BAND_WINDOWS;
+  }
+
+  switch (view->layer.surface->current.layer) {
+  case ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND:
+    return NORA_TREE_BAND_BACKGROUND;
+  case ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM:
+    return NORA_TREE_BAND_BOTTOM;
+  case ZWLR_LAYER_SHELL_V1_LAYER_TOP:
+    return NORA_TREE_BAND_TOP;
+  case ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY:
+    return NORA_TREE_BAND_OVERLAY;
+  }
+
+  return NORA_TREE_BAND_TOP;
+}
+
+static void nora_box_union(struct wlr_box *dest, const struct wlr_box *box) {
+  if (wlr_box_empty(box)) {
+    return;
+  }
+
+  if (wlr_box_empty(dest)) {
+    *dest = *box;
+    return;
+  }
+
+  int x1 = dest->x + dest->width > box->x + box->width ? dest->x + dest->width
+                                                       : box->x + box->width;
+  int y1 = dest->y + dest->height > box->y + box->height
+               ? dest->y + dest->height
+               : box->y + box->height;
+
+  dest->x = dest->x < box->x ? dest->x : box->x;
+  dest->y = dest->y < box->y ? dest->y : box->y;
+  dest->width = x1 - dest->x;
+  dest->height = y1 - dest->y;
+}
+
+static void nora_tree_container_add_bounds(struct nora_tree_container *container,
+                                           struct wlr_box *bounds) {
+  struct wlr_scene_node *scene_node = nora_tree_container_scene_node(container);
+  if (!container->mapped || container->surface == NULL || scene_node == NULL) {
+    return;
+  }
+
+  // The coordinates are taken regardless of whether the node is enabled, so
+  // switching workspaces does not invalidate the index.
+  int lx, ly;
+  wlr_scene_node_coords(scene_node, &lx, &ly);
+
+  // The scene offsets xdg surfaces by their window geometry.
+  struct wlr_box geometry = {0};
+  struct nora_view *view = container->view;
+  if (view->kind == NORA_VIEW_KIND_XDG_TOPLEVEL) {
+    wlr_xdg_surface_get_geometry(view->xdg_toplevel.xdg_toplevel->base,
+                                 &geometry);
+  } else if (view->kind == NORA_VIEW_KIND_XDG_POPUP) {
+    wlr_xdg_surface_get_geometry(view->xdg_popup.xdg_popup->base, &geometry);
+  }
+
+  struct wlr_box extents;
+  wlr_surface_get_extends(container->surface, &extents);
+  extents.x += lx - geometry.x;
+  extents.y += ly - geometry.y;
+  nora_box_union(bounds, &extents);
+
+  struct nora_tree_container *child;
+  wl_list_for_each(child, &container->children, link) {
+    if (!nora_tree_container_is_layer_popup(child)) {
+      nora_tree_container_add_bounds(child, bounds);
+    }
+  }
+}
+
+static void nora_tree_container_unindex(struct nora_tree_container *container) {
+  if (!container->indexed) {
+    return;
+  }
+
+  struct nora_tree_output *output;
+  wl_list_for_each(output, &container->root->outputs, link) {
+    nora_grid_remove(&output->grid, &container->box, container);
+  }
+
+  wl_list_remove(&container->index_link);
+  container->indexed = false;
+}
+
+static uint64_t nora_tree_container_z(struct nora_tree_container *container) {
+  return ((uint64_t)nora_tree_container_band(container) << 56) |
+         container->stack_serial;
+}
+
+static void nora_tree_container_reindex(struct nora_tree_container *container,
+                                        const struct wlr_box *box) {
+  nora_tree_container_unindex(container);
+
+  container->box = *box;
+  if (!container->mapped || wlr_box_empty(box)) {
+    return;
+  }
+
+  uint64_t z = nora_tree_container_z(container);
+
+  struct nora_tree_output *output;
+  wl_list_for_each(output, &container->root->outputs, link) {
+    nora_grid_insert(&output->grid, &container->box, z, container);
+  }
+
+  wl_list_insert(&container->root->indexed, &container->index_link);
+  container->indexed = true;
+}
+
+void nora_tree_container_update_bounds(struct nora_tree_container *container) {
+  NORA_TRACE_FUNC();
+  container = nora_tree_container_index_root(container);
+
+  if (container->root == NULL) {
+    return;
+  }
+
+  // Popups of a layer surface move along with it.
+  if (container->view->kind == NORA_VIEW_KIND_LAYER) {
+    struct nora_tree_container *child;
+    wl_list_for_each(child, &container->children, link) {
+      nora_tree_container_update_bounds(child);
+    }
+  }
+
+  struct wlr_box box = {0};
+  nora_tree_container_add_bounds(container, &box);
+
+  // Most commits do not change the geometry, keep those cheap.
+  if (container->indexed && wlr_box_equal(&box, &container->box)) {
+    return;
+  }
+
+  nora_tree_container_reindex(container, &box);
+}
+
+void nora_tree_container_set_mapped(struct nora_tree_container *container,
+                                    bool mapped) {
+  container->mapped = mapped;
+
+  if (mapped && nora_tree_container_index_root(container) == container &&
+      container->stack_serial == 0 && container->root != NULL) {
+    container->stack_serial = ++container->root->stack_serial;
+  }
+
+  nora_tree_container_update_bounds(container);
+}
+
+void nora_tree_container_raise(struct nora_tree_container *container) {
+  container = nora_tree_container_index_root(container);
+
+  if (container->root == NULL ||
+      container->stack_serial == container->root->stack_serial) {
+    return;
+  }
+
+  container->stack_serial = ++container->root->stack_serial;
+  if (container->indexed) {
+    struct wlr_box box = container->box;
+    nora_tree_container_reindex(container, &box);
+  }
+}
+
+void nora_tree_container_restack(struct nora_tree_container *container) {
+  container = nora_tree_container_index_root(container);
+
+  if (container->indexed) {
+    struct wlr_box box = container->box;
+    nora_tree_container_reindex(container, &box);
+  }
+}
+
+static void nora_tree_output_sync_grid(struct nora_tree_output *output) {
+  NORA_TRACE_FUNC();
+  struct wlr_box box;
+  wlr_output_layout_get_box(output->root->output_layout,
+                            output->output->wlr_output, &box);
+  if (wlr_box_equal(&box, &output->grid.box)) {
+    return;
+  }
+
+  // The output moved or changed mode, lay the grid out again.
+  nora_grid_reset(&output->grid, &box);
+
+  struct nora_tree_container *container;
+  wl_list_for_each(container, &output->root->indexed, index_link) {
+    nora_grid_insert(&output->grid, &container->box,
+                     nora_tree_container_z(container), container);
+  }
+}
+
+void nora_tree_workspace_set_fullscreen(struct nora_tree_workspace *workspace,
+                                        struct nora_tree_container *container) {
+  struct nora_tree_container *previous = workspace->fullscreen;
+  if (previous == container) {
+    return;
+  }
+
+  workspace->fullscreen = container;
+  workspace->output->workspaces_dirty = true;
+
+  // The stacking band of both containers changed.
+  if (previous != NULL && previous->indexed) {
+    struct wlr_box box = previous->box;
+    nora_tree_container_reindex(previous, &box);
+  }
+
+  if (container != NULL && container->indexed) {
+    struct wlr_box box = container->box;
+    nora_tree_container_reindex(container, &box);
+  }
+}
+
+static struct nora_tree_output *
+nora_tree_root_output_at(struct nora_tree_root *root, double lx, double ly) {
+  struct nora_tree_output *output;
+  wl_list_for_each(output, &root->outputs, link) {
+    nora_tree_output_sync_grid(output);
+    if (wlr_box_contains_point(&output->grid.box, lx, ly)) {
+      return output;
+    }
   }
+
+  return NULL;
 }
 
 struct nora_tree_container *
 nora_tree_root_find_container_at(struct nora_tree_root *root,
                                  struct wlr_surface **surface, double lx,
                                  double ly, double *sx, double *sy) {
-  struct wlr_scene_node *node =
-      wlr_scene_node_at(&root->scene->tree.node, lx, ly, sx, sy);
-  if (node == NULL || node->type != WLR_SCENE_NODE_BUFFER) {
+  NORA_TRACE_FUNC();
+  struct nora_tree_output *output = nora_tree_root_output_at(root, lx, ly);
+  if (output == NULL) {
     return NULL;
   }
 
-  struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
-  struct wlr_scene_surface *scene_surface =
-      wlr_scene_surface_try_from_buffer(scene_buffer);
-  if (!scene_surface) {
+  struct wl_array *cell = nora_grid_cell_at(&output->grid, lx, ly);
+  if (cell == NULL) {
     return NULL;
   }
 
-  *surface = scene_surface->surface;
-  return node->parent->node.data;
-}
+  // Walk the candidates from the top of the stack down, only descending into
+  // the scene of those whose bounds contain the point.
+  struct nora_grid_entry *entries = cell->data;
+  for (size_t i = cell->size / sizeof(*entries); i-- > 0;) {
+    struct nora_tree_container *candidate = entries[i].data;
+    if (!wlr_box_contains_point(&candidate->box, lx, ly)) {
+      continue;
+    }
 
-struct wlr_scene *nora_tree_root_present_scene(struct nora_tree_root *root) {
-  struct nora_tree_output *output, *tmp;
-  wl_list_for_each_safe(output, tmp, &root->outputs, link) {
-    nora_tree_output_prepare_present(output);
+    struct wlr_scene_node *scene_node =
+        nora_tree_container_scene_node(candidate);
+    int nx, ny;
+    if (scene_node == NULL || !wlr_scene_node_coords(scene_node, &nx, &ny)) {
+      // Lives on a workspace which is not shown, or is a popup whose parent
+      // is gone.
+      continue;
+    }
+
+    struct wlr_scene_node *node =
+        wlr_scene_node_at(scene_node, lx, ly, sx, sy);
+    if (node == NULL || node->type != WLR_SCENE_NODE_BUFFER) {
+      continue;
+    }
+
+    struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
+    struct wlr_scene_surface *scene_surface =
+        wlr_scene_surface_try_from_buffer(scene_buffer);
+    if (!scene_surface) {
+      continue;
+    }
+
+    *surface = scene_surface->surface;
+
+    // The hit may be a popup or subsurface of the candidate.
+    struct nora_tree_container *container =
+        nora_tree_root_find_container_by_surface(
+            root, wlr_surface_get_root_surface(scene_surface->surface));
+    return container != NULL ? container : candidate;
   }
 
-  return root->scene;
+  return NULL;
 }
 
 struct nora_tree_root *nora_tree_root_create(struct nora_server *server) {
   struct nora_tree_root *tree_root = calloc(1, sizeof(*tree_root));
 
+  tree_root->server = server;
   wl_list_init(&tree_root->outputs);
+  wl_list_init(&tree_root->detached);
+  wl_list_init(&tree_root->indexed);
+  nora_slab_init(&tree_root->container_slab, "container",
+                 sizeof(struct nora_tree_container));
 
+  tree_root->output_layout = server->desktop.output_layout;
   tree_root->scene = wlr_scene_create();
   tree_root->scene_output_layout = wlr_scene_attach_output_layout(
       tree_root->scene, server->desktop.output_layout);
@@ -189,41 +547,258 @@ nora_tree_root_current_workspace(struct nora_tree_root *root) {
   return NULL;
 }
 
-struct nora_tree_container *nora_tree_container_create() {
+struct nora_tree_container *
+nora_tree_container_create(struct nora_tree_root *root) {
   struct nora_tree_container *tree_container =
-      calloc(1, sizeof(*tree_container));
+      nora_slab_alloc(&root->container_slab);
+  if (tree_container == NULL) {
+    return NULL;
+  }
+
+  tree_container->root = root;
   wl_list_init(&tree_container->children);
+  wl_list_init(&tree_container->link);
+  wl_list_init(&tree_container->index_link);
   return tree_container;
 }
 
+void nora_tree_container_destroy(struct nora_tree_container *container) {
+  if (container->surface != NULL && container->surface->data == container) {
+    container->surface->data = NULL;
+  }
+
+  if (container->workspace != NULL &&
+      container->workspace->fullscreen == container) {
+    nora_tree_workspace_set_fullscreen(container->workspace, NULL);
+  }
+
+  nora_tree_container_unindex(container);
+
+  // Children outlive us only if the client misbehaves, detach them so they do
+  // not point back into freed memory.
+  struct nora_tree_container *child, *tmp;
+  wl_list_for_each_safe(child, tmp, &container->children, link) {
+    nora_tree_container_unindex(child);
+    wl_list_remove(&child->link);
+    wl_list_init(&child->link);
+    child->parent = NULL;
+    // Keeps the orphan out of the hit-test index until it is destroyed.
+    child->mapped = false;
+  }
+
+  struct nora_tree_container *parent = container->parent;
+
+  wl_list_remove(&container->link);
+  nora_slab_free(&container->root->container_slab, container);
+
+  if (parent != NULL) {
+    nora_tree_container_update_bounds(parent);
+  }
+}
+
 struct nora_tree_workspace *
-nora_tree_workspace_create(struct nora_tree_output *tree_output) {
+nora_tree_workspace_create(struct nora_tree_output *tree_output, uint32_t id) {
   struct nora_tree_workspace *tree_workspace =
       calloc(1, sizeof(*tree_workspace));
 
   tree_workspace->scene_tree =
-      wlr_scene_tree_create(&tree_output->root->scene->tree);
+      wlr_scene_tree_create(tree_output->workspaces_tree);
   tree_workspace->output = tree_output;
+  tree_workspace->id = id;
+  if (!tree_output->root->server->config.floating) {
+    tree_workspace->layout = nora_layout_create();
+  }
 
   wl_list_init(&tree_workspace->containers);
 
   return tree_workspace;
 }
 
-void nora_tree_root_attach_output(struct nora_tree_root *root,
-                                  struct nora_output *output) {
+static void nora_tree_workspace_destroy(struct nora_tree_workspace *workspace) {
+  assert(wl_list_empty(&workspace->containers));
+
+  if (workspace->layout != NULL) {
+    nora_layout_destroy(workspace->layout);
+  }
+
+  wlr_scene_node_destroy(&workspace->scene_tree->node);
+  wl_list_remove(&workspace->link);
+  free(workspace);
+}
+
+static void nora_tree_container_move(struct nora_tree_container *container,
+                                     struct nora_tree_workspace *target) {
+  struct nora_view *view = container->view;
+  struct nora_tree_output *output = target->output;
+
+  // The tiling tree is not carried over, the view is tiled again next to the
+  // focused view of the target.
+  bool tiled = view->kind == NORA_VIEW_KIND_XDG_TOPLEVEL &&
+               view->xdg_toplevel.tile.node != NULL;
+  if (tiled) {
+    nora_layout_remove_view(view);
+  }
+
+  wl_list_remove(&container->link);
+  nora_tree_workspace_insert_container(target, container);
+  view->output = output->output;
+
+  struct wlr_scene_node *node = nora_tree_container_scene_node(container);
+  wlr_scene_node_reparent(node, target->scene_tree);
+
+  if (tiled && target->layout != NULL) {
+    nora_layout_insert_view(target, view);
+  } else {
+    // Floating views which would end up off screen are moved onto it.
+    struct wlr_box box;
+    nora_output_usable_box(output->output, &box);
+    if (!wlr_box_contains_point(&box, node->x, node->y)) {
+      wlr_scene_node_set_position(node, box.x, box.y);
+    }
+  }
+
+  nora_tree_container_update_bounds(container);
+  nora_view_update_suspended(view);
+}
+
+// Moves every view of from to the workspace of the same id on to.
+static void nora_tree_output_evacuate(struct nora_tree_output *from,
+                                      struct nora_tree_output *to) {
+  struct nora_tree_workspace *workspace, *tmp_workspace;
+  wl_list_for_each_safe(workspace, tmp_workspace, &from->workspaces, link) {
+    struct nora_tree_workspace *target =
+        nora_tree_output_workspace(to, workspace->id);
+
+    // Inserting reverses the order, walk backwards to keep the stacking.
+    struct nora_tree_container *container, *tmp;
+    wl_list_for_each_reverse_safe(container, tmp, &workspace->containers,
+                                  link) {
+      nora_tree_container_move(container, target);
+    }
+
+    nora_tree_workspace_destroy(workspace);
+  }
+
+  to->workspaces_dirty = true;
+  wlr_output_schedule_frame(to->output->wlr_output);
+}
+
+static void nora_tree_output_destroy(struct nora_tree_output *tree_output) {
+  assert(wl_list_empty(&tree_output->workspaces));
+
+  nora_grid_finish(&tree_output->grid);
+  nora_layout_transaction_finish(&tree_output->transaction);
+  wlr_scene_node_destroy(&tree_output->scene_tree->node);
+
+  wl_list_remove(&tree_output->link);
+  free(tree_output);
+}
+
+// Creates an output with a first workspace, linked nowhere yet.
+static struct nora_tree_output *
+nora_tree_output_create(struct nora_tree_root *root) {
   struct nora_tree_output *tree_output = calloc(1, sizeof(*tree_output));
 
   tree_output->root = root;
-  tree_output->output = output;
 
+  wl_list_init(&tree_output->link);
   wl_list_init(&tree_output->workspaces);
   wl_list_init(&tree_output->containers);
+  nora_grid_init(&tree_output->grid);
+  nora_layout_transaction_init(
+      &tree_output->transaction, tree_output,
+      wl_display_get_event_loop(root->server->wl_display));
+
+  // Children are stacked in creation order.
+  struct wlr_scene_tree *scene_tree = wlr_scene_tree_create(&root->scene->tree);
+  tree_output->scene_tree = scene_tree;
+  tree_output->layers[ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND] =
+      wlr_scene_tree_create(scene_tree);
+  tree_output->layers[ZWLR_LAYER_SHELL_V1_LAYER_BOTTOM] =
+      wlr_scene_tree_create(scene_tree);
+  tree_output->workspaces_tree = wlr_scene_tree_create(scene_tree);
+  tree_output->layers[ZWLR_LAYER_SHELL_V1_LAYER_TOP] =
+      wlr_scene_tree_create(scene_tree);
+  tree_output->fullscreen_tree = wlr_scene_tree_create(scene_tree);
+  wlr_scene_node_set_enabled(&tree_output->fullscreen_tree->node, false);
+  tree_output->layers[ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY] =
+      wlr_scene_tree_create(scene_tree);
+  tree_output->popups_tree = wlr_scene_tree_create(scene_tree);
 
   // TODO: Improve this. For example, with workspace names etc.
   struct nora_tree_workspace *workspace =
-      nora_tree_workspace_create(tree_output);
+      nora_tree_output_workspace(tree_output, 0);
+  nora_tree_output_set_current_workspace(tree_output, workspace);
+
+  return tree_output;
+}
+
+struct nora_tree_output *
+nora_tree_root_attach_output(struct nora_tree_root *root,
+                             struct nora_output *output) {
+  struct nora_tree_output *tree_output = nora_tree_output_create(root);
+  tree_output->output = output;
 
-  wl_list_insert(&tree_output->workspaces, &workspace->link);
   wl_list_insert(&root->outputs, &tree_output->link);
+
+  // Views left behind by outputs which went away while none was left.
+  struct nora_tree_output *detached, *tmp;
+  wl_list_for_each_safe(detached, tmp, &root->detached, link) {
+    nora_tree_output_evacuate(detached, tree_output);
+    nora_tree_output_destroy(detached);
+  }
+
+  return tree_output;
+}
+
+void nora_tree_root_detach_output(struct nora_tree_root *root,
+                                  struct nora_tree_output *tree_output) {
+  assert(wl_list_empty(&tree_output->containers));
+
+  // Leave fullscreen while the output is still around to lay the views out.
+  struct nora_tree_workspace *workspace;
+  wl_list_for_each(workspace, &tree_output->workspaces, link) {
+    if (workspace->fullscreen != NULL) {
+      nora_view_set_fullscreen(workspace->fullscreen->view, false);
+    }
+  }
+
+  nora_layout_transaction_finish(&tree_output->transaction);
+
+  // Hit-tests stop looking at the output right away.
+  wl_list_remove(&tree_output->link);
+  wl_list_init(&tree_output->link);
+  tree_output->output = NULL;
+
+  if (wl_list_empty(&root->outputs)) {
+    wlr_log(WLR_INFO, "No output left, views wait for the next one");
+    wlr_scene_node_set_enabled(&tree_output->scene_tree->node, false);
+    wl_list_insert(&root->detached, &tree_output->link);
+
+    struct nora_tree_container *container;
+    wl_list_for_each(workspace, &tree_output->workspaces, link) {
+      wl_list_for_each(container, &workspace->containers, link) {
+        container->view->output = NULL;
+      }
+    }
+    return;
+  }
+
+  struct nora_tree_output *survivor =
+      wl_container_of(root->outputs.next, survivor, link);
+  nora_tree_output_evacuate(tree_output, survivor);
+  nora_tree_output_destroy(tree_output);
+}
+
+struct nora_tree_workspace *
+nora_tree_root_parked_workspace(struct nora_tree_root *root) {
+  if (wl_list_empty(&root->detached)) {
+    struct nora_tree_output *tree_output = nora_tree_output_create(root);
+    wlr_scene_node_set_enabled(&tree_output->scene_tree->node, false);
+    wl_list_insert(&root->detached, &tree_output->link);
+  }
+
+  struct nora_tree_output *parked =
+      wl_container_of(root->detached.next, parked, link);
+  return nora_tree_output_current_workspace(parked);
 }
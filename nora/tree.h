@@ -4,17 +4,50 @@
 #include <assert.h>
 
 #include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_scene.h>
 
+#include "grid.h"
+#include "layout.h"
+#include "slab.h"
+
 struct nora_output;
 struct nora_server;
 struct nora_view;
 
+// Stacking bands used to order hit-test candidates, a container in a higher
+// band is always above one in a lower band.
+enum nora_tree_band {
+  NORA_TREE_BAND_BACKGROUND,
+  NORA_TREE_BAND_BOTTOM,
+  NORA_TREE_BAND_WINDOWS,
+  NORA_TREE_BAND_TOP,
+  NORA_TREE_BAND_FULLSCREEN,
+  NORA_TREE_BAND_OVERLAY,
+  // Popups of layer surfaces, see nora_tree_output::popups_tree.
+  NORA_TREE_BAND_POPUP,
+};
+
+// One scene tree per layer shell layer.
+#define NORA_TREE_LAYERS 4
+
 struct nora_tree_root {
+  struct nora_server *server;
+
   struct wl_list outputs;
+  // Outputs detached while no other output was left, their workspaces move
+  // to the next output attached.
+  struct wl_list detached; // nora_tree_output::link
+  struct wl_list indexed; // nora_tree_container::index_link
 
   struct wlr_scene *scene;
   struct wlr_scene_output_layout *scene_output_layout;
+  struct wlr_output_layout *output_layout;
+
+  uint64_t stack_serial;
+
+  // Every nora_tree_container is allocated from here.
+  struct nora_slab container_slab;
 };
 
 struct nora_tree_output {
@@ -24,16 +57,55 @@ struct nora_tree_output {
 
   struct nora_tree_root *root;
 
+  // NULL while detached.
   struct nora_output *output;
+
+  // Mapped top-level containers intersecting this output, used for hit-tests.
+  struct nora_grid grid;
+
+  /* Everything shown on this output lives below scene_tree, stacked from
+   * the bottom up:
+   *
+   *   layers[BACKGROUND], layers[BOTTOM], workspaces_tree, layers[TOP],
+   *   fullscreen_tree, layers[OVERLAY], popups_tree
+   *
+   * The order is fixed when the output is attached and never depends on the
+   * order in which clients create their surfaces. */
+  struct wlr_scene_tree *scene_tree;
+  // Layer surfaces of this output, indexed by zwlr_layer_shell_v1_layer.
+  struct wlr_scene_tree *layers[NORA_TREE_LAYERS];
+  struct wlr_scene_tree *workspaces_tree;
+  // Fullscreen views of this output's workspaces are moved here, above
+  // everything but the overlay layer.
+  struct wlr_scene_tree *fullscreen_tree;
+  // Popups of layer surfaces, so that they are never covered by views.
+  struct wlr_scene_tree *popups_tree;
+
+  // Configures of the tiled views on this output's workspaces.
+  struct nora_layout_transaction transaction;
+
+  struct nora_tree_workspace *current_workspace;
+  // Set when current_workspace changes, the scene nodes of the workspaces are
+  // updated on the next frame.
+  bool workspaces_dirty;
 };
 
 struct nora_tree_workspace {
   struct wl_list link; // nora_tree_output::workspaces;
   struct wl_list containers;
 
+  uint32_t id;
+
   struct nora_tree_output *output;
 
   struct wlr_scene_tree *scene_tree;
+
+  // Tiling tree of the workspace, NULL if its views float.
+  struct nora_layout_node *layout;
+
+  // While set, the rest of the workspace is disabled so the fullscreen view
+  // is the only thing left to present and can be scanned out directly.
+  struct nora_tree_container *fullscreen;
 };
 
 struct nora_tree_container {
@@ -42,15 +114,40 @@ struct nora_tree_container {
             // || nora_tree_container::children;
   struct wl_list children;
 
+  struct nora_tree_root *root;
+  struct nora_tree_container *parent;
+  struct nora_tree_workspace *workspace;
+
   struct nora_view *view;
+  // surface->data points back at this container while it is in the tree.
   struct wlr_surface *surface;
 
   bool ownable;
+  bool mapped;
+
+  // Only containers without a parent and popups of layer surfaces are
+  // indexed, their box covers the container and all of its mapped children
+  // in layout coordinates, popups of layer surfaces excluded.
+  struct wl_list index_link; // nora_tree_root::indexed
+  bool indexed;
+  struct wlr_box box;
+  uint64_t stack_serial;
 };
 
 struct nora_tree_root *nora_tree_root_create(struct nora_server *server);
-void nora_tree_root_attach_output(struct nora_tree_root *root,
-                                  struct nora_output *output);
+struct nora_tree_output *
+nora_tree_root_attach_output(struct nora_tree_root *root,
+                             struct nora_output *output);
+// Called before the output goes away, its layer surfaces must already be
+// destroyed. Its workspaces are merged into the workspaces of the same id on
+// another output.
+void nora_tree_root_detach_output(struct nora_tree_root *root,
+                                  struct nora_tree_output *tree_output);
+// Current workspace of the first detached output, for views created while no
+// output is attached. Parks an output without workspaces if there is none
+// yet, its views move to the next output attached.
+struct nora_tree_workspace *
+nora_tree_root_parked_workspace(struct nora_tree_root *root);
 struct nora_tree_container *
 nora_tree_root_find_container_by_surface(struct nora_tree_root *root,
                                          struct wlr_surface *surface);
@@ -58,32 +155,41 @@ struct nora_tree_container *
 nora_tree_root_find_container_at(struct nora_tree_root *root,
                                  struct wlr_surface **surface, double lx,
                                  double ly, double *sx, double *sy);
-struct wlr_scene *nora_tree_root_present_scene(struct nora_tree_root *root);
 struct nora_tree_workspace *
 nora_tree_root_current_workspace(struct nora_tree_root *root);
 
 struct nora_tree_workspace *
 nora_tree_output_current_workspace(struct nora_tree_output *output);
+struct nora_tree_workspace *
+nora_tree_output_workspace(struct nora_tree_output *output, uint32_t id);
+struct nora_tree_workspace *
+nora_tree_workspace_create(struct nora_tree_output *tree_output, uint32_t id);
+void nora_tree_output_set_current_workspace(
+    struct nora_tree_output *output, struct nora_tree_workspace *workspace);
 void nora_tree_workspace_insert_container(
     struct nora_tree_workspace *workspace,
     struct nora_tree_container *container);
-struct nora_tree_container *nora_tree_workspace_find_container_by_surface(
-    struct nora_tree_workspace *workspace, struct wlr_surface *surface);
+void nora_tree_workspace_set_fullscreen(struct nora_tree_workspace *workspace,
+                                        struct nora_tree_container *container);
 void nora_tree_workspace_disable(struct nora_tree_workspace *workspace);
 void nora_tree_workspace_enable(struct nora_tree_workspace *workspace);
 
 void nora_tree_output_insert_container(struct nora_tree_output *output,
                                        struct nora_tree_container *container);
-struct nora_tree_container *
-nora_tree_output_find_container_by_surface(struct nora_tree_output *output,
-                                           struct wlr_surface *surface);
 void nora_tree_output_prepare_present(struct nora_tree_output *output);
 
 bool nora_tree_container_is_ownable(struct nora_tree_container *container);
-struct nora_tree_container *nora_tree_container_find_container_by_surface(
-    struct nora_tree_container *parent, struct wlr_surface *surface);
-struct nora_tree_container *nora_tree_container_create();
+// Returns NULL if out of memory.
+struct nora_tree_container *
+nora_tree_container_create(struct nora_tree_root *root);
+void nora_tree_container_destroy(struct nora_tree_container *container);
 void nora_tree_container_insert_child(struct nora_tree_container *parent,
                                       struct nora_tree_container *child);
+void nora_tree_container_set_mapped(struct nora_tree_container *container,
+                                    bool mapped);
+void nora_tree_container_update_bounds(struct nora_tree_container *container);
+void nora_tree_container_raise(struct nora_tree_container *container);
+// Re-indexes the container after its stacking band changed.
+void nora_tree_container_restack(struct nora_tree_container *container);
 
 #endif // NORA_TREE_H
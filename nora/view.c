@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <wayland-server-core.h>
 
@@ -13,26 +14,222 @@
 #include <wlr/types/wlr_xdg_decoration_v1.h>
 #include <wlr/types/wlr_xdg_shell.h>
 
+#include "layout.h"
 #include "nora/desktop/manager.h"
 #include "output.h"
 #include "server.h"
+#include "trace.h"
 #include "view.h"
 
-static void nora_arrange_layers(struct nora_output *output) {
-  // TODO Implement layer shell arrangement
+static size_t *nora_view_live_count(struct nora_server *server,
+                                    enum nora_view_kind kind) {
+  switch (kind) {
+  case NORA_VIEW_KIND_XDG_TOPLEVEL:
+    return &server->live_views.toplevels;
+  case NORA_VIEW_KIND_XDG_POPUP:
+    return &server->live_views.popups;
+  case NORA_VIEW_KIND_LAYER:
+    return &server->live_views.layers;
+  }
+
+  UNREACHABLE();
+}
+
+/* Allocates a view along with its container, so that callers have a single
+ * failure to handle. Returns NULL if out of memory. */
+static struct nora_view *nora_view_create(struct nora_server *server,
+                                          enum nora_view_kind kind) {
+  struct nora_view *view = nora_slab_alloc(&server->view_slab);
+  if (view == NULL) {
+    return NULL;
+  }
+
+  struct nora_tree_container *container =
+      nora_tree_container_create(server->tree_root);
+  if (container == NULL) {
+    nora_slab_free(&server->view_slab, view);
+    return NULL;
+  }
+
+  container->view = view;
+  view->container = container;
+  view->server = server;
+  view->kind = kind;
+
+  ++*nora_view_live_count(server, kind);
+  return view;
+}
+
+/* The view must already be unlinked from everything, its container
+ * included. */
+static void nora_view_destroy(struct nora_view *view) {
+  --*nora_view_live_count(view->server, view->kind);
+  nora_slab_free(&view->server->view_slab, view);
+}
+
+void nora_view_log_stats(struct nora_server *server) {
+  wlr_log(WLR_INFO,
+          "Views: %zu toplevels, %zu popups, %zu layer surfaces alive",
+          server->live_views.toplevels, server->live_views.popups,
+          server->live_views.layers);
+  nora_slab_log_stats(&server->view_slab);
+
+  struct nora_slab *containers = &server->tree_root->container_slab;
+  nora_slab_log_stats(containers);
+
+  // Every view owns exactly one container for as long as it lives.
+  if (containers->stats.in_use != server->view_slab.stats.in_use) {
+    wlr_log(WLR_ERROR, "%zu containers for %zu views, containers leaked",
+            containers->stats.in_use, server->view_slab.stats.in_use);
+  }
+}
+
+static void nora_view_apply_maximized(struct nora_view *view);
+
+static void nora_arrange_layer(struct nora_output *output, uint32_t layer,
+                               bool exclusive,
+                               const struct wlr_box *full_area,
+                               struct wlr_box *usable_area) {
+  struct nora_tree_container *container;
+  wl_list_for_each(container, &output->tree_output->containers, link) {
+    struct nora_view *view = container->view;
+    if (view->kind != NORA_VIEW_KIND_LAYER) {
+      continue;
+    }
+
+    struct wlr_layer_surface_v1 *surface = view->layer.surface;
+    if (!surface->initialized || surface->current.layer != layer ||
+        (surface->current.exclusive_zone > 0) != exclusive) {
+      continue;
+    }
+
+    wlr_scene_layer_surface_v1_configure(view->layer.scene_tree, full_area,
+                                         usable_area);
+
+    struct wlr_scene_node *node = &view->layer.scene_tree->tree->node;
+    wlr_scene_node_set_position(&view->layer.popup_tree->node, node->x,
+                                node->y);
+  }
+}
+
+void nora_arrange_layers(struct nora_output *output) {
+  NORA_TRACE_FUNC();
+  struct wlr_box full_area;
+  wlr_output_layout_get_box(output->server->desktop.output_layout,
+                            output->wlr_output, &full_area);
+  if (wlr_box_empty(&full_area)) {
+    return;
+  }
+
+  /* Surfaces reserving an exclusive zone are placed first, from the top
+   * layer down, every other surface gets what they left over. */
+  struct wlr_box usable_area = full_area;
+  for (int layer = ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY;
+       layer >= ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND; --layer) {
+    nora_arrange_layer(output, layer, true, &full_area, &usable_area);
+  }
+  for (int layer = ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY;
+       layer >= ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND; --layer) {
+    nora_arrange_layer(output, layer, false, &full_area, &usable_area);
+  }
+
+  struct nora_tree_container *container;
+  wl_list_for_each(container, &output->tree_output->containers, link) {
+    nora_tree_container_update_bounds(container);
+  }
+
+  uint32_t left = usable_area.x - full_area.x;
+  uint32_t top = usable_area.y - full_area.y;
+  uint32_t right = full_area.width - usable_area.width - left;
+  uint32_t bottom = full_area.height - usable_area.height - top;
+  bool changed = output->excluded_margin.left != left ||
+                 output->excluded_margin.top != top ||
+                 output->excluded_margin.right != right ||
+                 output->excluded_margin.bottom != bottom;
+
+  output->excluded_margin.left = left;
+  output->excluded_margin.top = top;
+  output->excluded_margin.right = right;
+  output->excluded_margin.bottom = bottom;
+
+  // Tiled workspaces follow the usable area, which is cheap if it is the box
+  // they were last arranged in.
+  struct nora_tree_workspace *workspace;
+  wl_list_for_each(workspace, &output->tree_output->workspaces, link) {
+    nora_layout_arrange(workspace);
+  }
+
+  if (!changed) {
+    return;
+  }
+
+  // So do maximized views.
+  wl_list_for_each(workspace, &output->tree_output->workspaces, link) {
+    wl_list_for_each(container, &workspace->containers, link) {
+      struct nora_view *view = container->view;
+      if (view->kind == NORA_VIEW_KIND_XDG_TOPLEVEL &&
+          view->xdg_toplevel.maximized && !view->xdg_toplevel.fullscreen) {
+        nora_view_apply_maximized(view);
+        nora_tree_container_update_bounds(container);
+      }
+    }
+  }
+}
+
+/* Returns true if the commit changed anything the arrangement depends on and
+ * remembers the new state. */
+static bool nora_layer_update_arranged(struct nora_view *view) {
+  const struct wlr_layer_surface_v1_state *state =
+      &view->layer.surface->current;
+  struct nora_layer_state arranged = {
+      .layer = state->layer,
+      .anchor = state->anchor,
+      .exclusive_zone = state->exclusive_zone,
+      .margin_top = state->margin.top,
+      .margin_right = state->margin.right,
+      .margin_bottom = state->margin.bottom,
+      .margin_left = state->margin.left,
+      .desired_width = state->desired_width,
+      .desired_height = state->desired_height,
+  };
+
+  if (memcmp(&arranged, &view->layer.arranged, sizeof(arranged)) == 0) {
+    return false;
+  }
+
+  view->layer.arranged = arranged;
+  return true;
 }
 
 static void on_layer_commit(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   (void)data;
 
   struct nora_view *view = wl_container_of(listener, view, layer.commit);
   assert(view != NULL);
 
-  wlr_log(WLR_INFO, "View: (%s) requested to be committed",
-          view->layer.surface->namespace);
+  struct wlr_layer_surface_v1 *surface = view->layer.surface;
+  uint32_t previous_layer = view->layer.arranged.layer;
+
+  bool changed = nora_layer_update_arranged(view);
+  if (!surface->initial_commit && !changed) {
+    // Most commits only carry new buffers.
+    nora_tree_container_update_bounds(view->container);
+    return;
+  }
+
+  if (surface->current.layer != previous_layer) {
+    wlr_scene_node_reparent(
+        &view->layer.scene_tree->tree->node,
+        view->output->tree_output->layers[surface->current.layer]);
+    nora_tree_container_restack(view->container);
+  }
+
+  nora_arrange_layers(view->output);
 }
 
 static void on_layer_map(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   (void)data;
 
   struct nora_view *view = wl_container_of(listener, view, map);
@@ -40,9 +237,13 @@ static void on_layer_map(struct wl_listener *listener, void *data) {
 
   wlr_log(WLR_INFO, "View: (%s) requested to be mapped",
           view->layer.surface->namespace);
+
+  nora_tree_container_set_mapped(view->container, true);
+  nora_arrange_layers(view->output);
 }
 
 static void on_layer_unmap(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   (void)data;
 
   struct nora_view *view = wl_container_of(listener, view, unmap);
@@ -50,9 +251,13 @@ static void on_layer_unmap(struct wl_listener *listener, void *data) {
 
   wlr_log(WLR_INFO, "View: (%s) requested to be unmapped",
           view->layer.surface->namespace);
+
+  nora_tree_container_set_mapped(view->container, false);
+  nora_arrange_layers(view->output);
 }
 
 static void on_layer_destroy(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   (void)data;
 
   struct nora_view *view = wl_container_of(listener, view, destroy);
@@ -60,33 +265,65 @@ static void on_layer_destroy(struct wl_listener *listener, void *data) {
 
   wlr_log(WLR_INFO, "View: (%s) requested to be destroyed",
           view->layer.surface->namespace);
+
+  nora_tree_container_destroy(view->container);
+  view->container = NULL;
+
+  wlr_scene_node_destroy(&view->layer.popup_tree->node);
+
+  wl_list_remove(&view->map.link);
+  wl_list_remove(&view->unmap.link);
+  wl_list_remove(&view->destroy.link);
+  wl_list_remove(&view->layer.new_popup.link);
+  wl_list_remove(&view->layer.commit.link);
+
+  nora_view_destroy(view);
 }
 
+static void nora_xdg_popup_create(struct nora_server *server,
+                                  struct wlr_xdg_popup *popup,
+                                  struct nora_tree_container *parent_container);
+
 static void on_layer_new_popup(struct wl_listener *listener, void *data) {
-  (void)data;
+  NORA_TRACE_FUNC();
+  struct wlr_xdg_popup *popup = data;
 
   struct nora_view *view = wl_container_of(listener, view, layer.new_popup);
   assert(view != NULL);
 
   wlr_log(WLR_INFO, "View: (%s) requested a new popup",
           view->layer.surface->namespace);
+
+  nora_xdg_popup_create(view->server, popup, view->container);
 }
 
 void nora_new_layer_surface(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   struct nora_server *server =
       wl_container_of(listener, server, desktop.new_layer_surface);
   assert(server != NULL);
 
   struct wlr_layer_surface_v1 *surface = data;
 
-  struct nora_view *view = calloc(1, sizeof(*view));
-  view->kind = NORA_VIEW_KIND_LAYER;
-  view->server = server;
+  // The client lets us pick the output.
+  if (surface->output == NULL) {
+    struct nora_output *current = nora_get_current_output(server);
+    if (current == NULL) {
+      wlr_log(WLR_ERROR, "No output for layer surface (%s)",
+              surface->namespace);
+      wlr_layer_surface_v1_destroy(surface);
+      return;
+    }
+    surface->output = current->wlr_output;
+  }
 
-  view->layer.surface = surface;
-  view->layer.scene_tree = wlr_scene_layer_surface_v1_create(
-      &server->tree_root->scene->tree, surface);
-  view->layer.scene_tree->tree->node.data = view;
+  struct nora_view *view = nora_view_create(server, NORA_VIEW_KIND_LAYER);
+  if (view == NULL) {
+    wlr_log(WLR_ERROR, "Out of memory for layer surface (%s)",
+            surface->namespace);
+    wlr_layer_surface_v1_destroy(surface);
+    return;
+  }
 
   view->layer.commit.notify = on_layer_commit;
   wl_signal_add(&surface->surface->events.commit, &view->layer.commit);
@@ -110,7 +347,20 @@ void nora_new_layer_surface(struct wl_listener *listener, void *data) {
       nora_output_of_wlr_output(server, surface->output);
   view->output = output;
 
-  nora_arrange_layers(output);
+  view->layer.surface = surface;
+  view->layer.scene_tree = wlr_scene_layer_surface_v1_create(
+      output->tree_output->layers[surface->pending.layer], surface);
+  view->layer.scene_tree->tree->node.data = view;
+  view->layer.popup_tree =
+      wlr_scene_tree_create(output->tree_output->popups_tree);
+  view->layer.arranged.layer = surface->pending.layer;
+
+  struct nora_tree_container *container = view->container;
+  container->ownable = false;
+  container->surface = surface->surface;
+
+  // The surface is arranged once its initial commit arrives.
+  nora_tree_output_insert_container(output->tree_output, container);
 }
 
 static void nora_view_begin_interactive(struct nora_view *view,
@@ -122,6 +372,11 @@ static void nora_view_begin_interactive(struct nora_view *view,
   struct nora_server *server = view->server;
   struct wlr_surface *focused_surface =
       server->input.seat->pointer_state.focused_surface;
+  if (view->xdg_toplevel.tile.node != NULL) {
+    /* Tiled views are placed by the layout. */
+    return;
+  }
+
   if (view->xdg_toplevel.xdg_toplevel->base->surface !=
       wlr_surface_get_root_surface(focused_surface)) {
     /* Deny move/resize requests from unfocused clients. */
@@ -157,20 +412,140 @@ static void nora_view_begin_interactive(struct nora_view *view,
 }
 
 static void on_xdg_toplevel_map(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   /* Called when the surface is mapped, or ready to display on-screen. */
   struct nora_view *view = wl_container_of(listener, view, map);
+
+  nora_tree_container_set_mapped(view->container, true);
+  nora_view_update_suspended(view);
 }
 
 static void on_xdg_toplevel_unmap(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   /* Called when the surface is unmapped, and should no longer be shown. */
   struct nora_view *view = wl_container_of(listener, view, unmap);
+
+  nora_tree_container_set_mapped(view->container, false);
+
+  if (view->xdg_toplevel.tile.node != NULL) {
+    nora_layout_remove_view(view);
+    nora_layout_arrange(view->container->workspace);
+  }
+}
+
+static void nora_view_send_resize(struct nora_view *view) {
+  view->xdg_toplevel.resize.inflight = view->xdg_toplevel.resize.pending;
+  view->xdg_toplevel.resize.has_pending = false;
+  view->xdg_toplevel.resize.serial = wlr_xdg_toplevel_set_size(
+      view->xdg_toplevel.xdg_toplevel,
+      view->xdg_toplevel.resize.inflight.width,
+      view->xdg_toplevel.resize.inflight.height);
+}
+
+void nora_view_resize(struct nora_view *view, struct wlr_box box,
+                      uint32_t edges) {
+  assert(view->kind == NORA_VIEW_KIND_XDG_TOPLEVEL);
+
+  view->xdg_toplevel.resize.pending = box;
+  view->xdg_toplevel.resize.has_pending = true;
+  view->xdg_toplevel.resize.edges = edges;
+
+  // The client has not caught up with the previous configure yet, the latest
+  // box is sent once it has.
+  if (view->xdg_toplevel.resize.serial != 0) {
+    return;
+  }
+
+  nora_view_send_resize(view);
+}
+
+void nora_view_flush_resize(struct nora_view *view) {
+  assert(view->kind == NORA_VIEW_KIND_XDG_TOPLEVEL);
+
+  if (!view->xdg_toplevel.resize.has_pending) {
+    return;
+  }
+
+  if (wlr_box_equal(&view->xdg_toplevel.resize.pending,
+                    &view->xdg_toplevel.resize.inflight)) {
+    view->xdg_toplevel.resize.has_pending = false;
+    return;
+  }
+
+  nora_view_send_resize(view);
+}
+
+static void nora_view_apply_resize(struct nora_view *view) {
+  struct wlr_xdg_surface *xdg_surface = view->xdg_toplevel.xdg_toplevel->base;
+  uint32_t serial = view->xdg_toplevel.resize.serial;
+  if (serial == 0 ||
+      (int32_t)(xdg_surface->current.configure_serial - serial) < 0) {
+    return;
+  }
+
+  /* The client committed a buffer for the configure, move the view along
+   * with it so the anchored edges stay put whatever size it picked. */
+  struct wlr_box geo_box;
+  wlr_xdg_surface_get_geometry(xdg_surface, &geo_box);
+
+  struct wlr_box *box = &view->xdg_toplevel.resize.inflight;
+  uint32_t edges = view->xdg_toplevel.resize.edges;
+
+  int x = (edges & WLR_EDGE_LEFT) ? box->x + box->width - geo_box.width
+                                  : box->x;
+  int y = (edges & WLR_EDGE_TOP) ? box->y + box->height - geo_box.height
+                                 : box->y;
+  wlr_scene_node_set_position(&view->xdg_toplevel.scene_tree->node,
+                              x - geo_box.x, y - geo_box.y);
+
+  view->xdg_toplevel.resize.serial = 0;
+  nora_view_flush_resize(view);
+}
+
+static void on_xdg_toplevel_commit(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
+  struct nora_view *view =
+      wl_container_of(listener, view, xdg_toplevel.commit);
+
+  struct wlr_xdg_toplevel *toplevel = view->xdg_toplevel.xdg_toplevel;
+  if (toplevel->base->initial_commit) {
+    /* Tiled views get their size from the very first configure, floating
+     * ones pick their own. */
+    struct nora_tree_workspace *workspace = view->container->workspace;
+    if (workspace != NULL && workspace->layout != NULL) {
+      nora_layout_insert_view(workspace, view);
+    }
+
+    if (view->xdg_toplevel.tile.serial == 0) {
+      wlr_xdg_toplevel_set_size(toplevel, 0, 0);
+    }
+    return;
+  }
+
+  nora_layout_view_commit(view);
+  nora_view_apply_resize(view);
+  nora_tree_container_update_bounds(view->container);
 }
 
 static void on_xdg_toplevel_destroy(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   /* Called when the surface is destroyed and should never be shown again. */
   struct nora_view *view = wl_container_of(listener, view, destroy);
 
+  if (view->server->input.grabbed_view == view) {
+    view->server->input.cursor_mode = NORA_CURSOR_PASSTHROUGH;
+    view->server->input.grabbed_view = NULL;
+  }
+
+  // Views destroyed before they were ever mapped are still tiled.
+  if (view->xdg_toplevel.tile.node != NULL) {
+    nora_layout_remove_view(view);
+    nora_layout_arrange(view->container->workspace);
+  }
+
+  wl_list_remove(&view->xdg_toplevel.request_hide.link);
   nora_desktop_view_handle_unstable_v1_destroy(view->view_handle);
+  nora_tree_container_destroy(view->container);
 
   wl_list_remove(&view->map.link);
   wl_list_remove(&view->unmap.link);
@@ -183,14 +558,14 @@ static void on_xdg_toplevel_destroy(struct wl_listener *listener, void *data) {
 
   wl_list_remove(&view->xdg_toplevel.set_app_id.link);
   wl_list_remove(&view->xdg_toplevel.set_title.link);
+  wl_list_remove(&view->xdg_toplevel.commit.link);
 
-  free(view);
+  nora_view_destroy(view);
 }
 
 static void on_xdg_toplevel_request_move(struct wl_listener *listener,
                                          void *data) {
-  // TODO: Check the current tiling mode in the surface's workspace.
-
+  NORA_TRACE_FUNC();
   struct nora_view *view =
       wl_container_of(listener, view, xdg_toplevel.request_move);
   nora_view_begin_interactive(view, NORA_CURSOR_MOVE, 0);
@@ -198,7 +573,7 @@ static void on_xdg_toplevel_request_move(struct wl_listener *listener,
 
 static void on_xdg_toplevel_request_resize(struct wl_listener *listener,
                                            void *data) {
-  // TODO: Check the current tiling mode in the surface's workspace.
+  NORA_TRACE_FUNC();
   struct wlr_xdg_toplevel_resize_event *event = data;
 
   struct nora_view *view =
@@ -207,22 +582,224 @@ static void on_xdg_toplevel_request_resize(struct wl_listener *listener,
   nora_view_begin_interactive(view, NORA_CURSOR_RESIZE, event->edges);
 }
 
-// TODO: Implement maximize and fullscreen events.
+static bool nora_view_is_shown(struct nora_view *view) {
+  struct nora_tree_workspace *workspace = view->container->workspace;
+  if (view->xdg_toplevel.hidden || workspace == NULL ||
+      workspace->output->output == NULL) {
+    return false;
+  }
+
+  if (nora_tree_output_current_workspace(workspace->output) != workspace) {
+    return false;
+  }
+
+  // Only the visible tab of a tabbed or stacked node is shown.
+  struct nora_layout_node *node = view->xdg_toplevel.tile.node;
+  if (node != NULL && !node->shown && !view->xdg_toplevel.fullscreen) {
+    return false;
+  }
+
+  return workspace->fullscreen == NULL ||
+         workspace->fullscreen == view->container;
+}
+
+void nora_view_update_suspended(struct nora_view *view) {
+  if (view->kind != NORA_VIEW_KIND_XDG_TOPLEVEL) {
+    return;
+  }
+
+  /* Disabled scene nodes already get no frame callbacks, the suspended state
+   * lets the client stop rendering altogether. */
+  bool suspended = !nora_view_is_shown(view);
+  if (view->xdg_toplevel.suspended == suspended) {
+    return;
+  }
+
+  view->xdg_toplevel.suspended = suspended;
+
+  struct wlr_xdg_toplevel *toplevel = view->xdg_toplevel.xdg_toplevel;
+  if (wl_resource_get_version(toplevel->resource) >=
+      XDG_TOPLEVEL_STATE_SUSPENDED_SINCE_VERSION) {
+    wlr_xdg_toplevel_set_suspended(toplevel, suspended);
+  }
+}
+
+void nora_view_set_hidden(struct nora_view *view, bool hidden) {
+  assert(view->kind == NORA_VIEW_KIND_XDG_TOPLEVEL);
+
+  if (view->xdg_toplevel.hidden == hidden) {
+    return;
+  }
+
+  view->xdg_toplevel.hidden = hidden;
+
+  // Tabbed and stacked layouts show one of their views only, and a copy of
+  // the buffers stands in for the view during a layout transaction.
+  struct nora_layout_node *node = view->xdg_toplevel.tile.node;
+  wlr_scene_node_set_enabled(&view->xdg_toplevel.scene_tree->node,
+                             !hidden && (node == NULL || node->shown) &&
+                                 view->xdg_toplevel.tile.saved == NULL);
+  if (hidden) {
+    nora_layout_view_restore(view);
+  }
+
+  if (hidden && view->server->input.seat->keyboard_state.focused_surface ==
+                    view->xdg_toplevel.xdg_toplevel->base->surface) {
+    wlr_seat_keyboard_notify_clear_focus(view->server->input.seat);
+  }
+
+  nora_view_update_suspended(view);
+  nora_desktop_view_handle_unstable_v1_set_hidden(view->view_handle, hidden);
+}
+
+static void on_view_handle_request_hide(struct wl_listener *listener,
+                                        void *data) {
+  NORA_TRACE_FUNC();
+  struct nora_view *view =
+      wl_container_of(listener, view, xdg_toplevel.request_hide);
+  nora_view_set_hidden(view, true);
+}
+
+static void nora_view_save_box(struct nora_view *view) {
+  if (view->xdg_toplevel.fullscreen || view->xdg_toplevel.maximized) {
+    return;
+  }
+
+  struct wlr_box geo_box;
+  wlr_xdg_surface_get_geometry(view->xdg_toplevel.xdg_toplevel->base, &geo_box);
+
+  view->xdg_toplevel.box = (struct wlr_box){
+      .x = view->xdg_toplevel.scene_tree->node.x,
+      .y = view->xdg_toplevel.scene_tree->node.y,
+      .width = geo_box.width,
+      .height = geo_box.height,
+  };
+}
+
+static void nora_view_restore_box(struct nora_view *view) {
+  struct wlr_box *box = &view->xdg_toplevel.box;
+  wlr_scene_node_set_position(&view->xdg_toplevel.scene_tree->node, box->x,
+                              box->y);
+  // A zero size lets the client pick, which is what it had before.
+  wlr_xdg_toplevel_set_size(view->xdg_toplevel.xdg_toplevel, box->width,
+                            box->height);
+}
+
+void nora_view_set_fullscreen(struct nora_view *view, bool fullscreen) {
+  assert(view->kind == NORA_VIEW_KIND_XDG_TOPLEVEL);
+
+  struct nora_tree_workspace *workspace = view->container->workspace;
+  if (workspace == NULL || workspace->output->output == NULL ||
+      view->xdg_toplevel.fullscreen == fullscreen) {
+    wlr_xdg_surface_schedule_configure(view->xdg_toplevel.xdg_toplevel->base);
+    return;
+  }
+
+  struct nora_tree_output *tree_output = workspace->output;
+  struct wlr_scene_node *node = &view->xdg_toplevel.scene_tree->node;
+
+  if (fullscreen) {
+    if (workspace->fullscreen != NULL) {
+      nora_view_set_fullscreen(workspace->fullscreen->view, false);
+    }
+
+    nora_view_save_box(view);
+    // Fullscreen views are not held back by the layout.
+    nora_layout_view_restore(view);
+
+    struct wlr_box output_box;
+    wlr_output_layout_get_box(view->server->desktop.output_layout,
+                              tree_output->output->wlr_output, &output_box);
+
+    /* Sized to the output and moved above everything else, the rest of the
+     * workspace is disabled on the next frame so the scene can scan the
+     * view out directly. */
+    wlr_scene_node_reparent(node, tree_output->fullscreen_tree);
+    wlr_scene_node_set_position(node, output_box.x, output_box.y);
+    wlr_xdg_toplevel_set_size(view->xdg_toplevel.xdg_toplevel,
+                              output_box.width, output_box.height);
+    wlr_xdg_toplevel_set_fullscreen(view->xdg_toplevel.xdg_toplevel, true);
+
+    view->xdg_toplevel.fullscreen = true;
+    nora_tree_workspace_set_fullscreen(workspace, view->container);
+  } else {
+    view->xdg_toplevel.fullscreen = false;
+    nora_tree_workspace_set_fullscreen(workspace, NULL);
+
+    wlr_scene_node_reparent(node, workspace->scene_tree);
+    wlr_scene_node_set_enabled(node, true);
+    wlr_xdg_toplevel_set_fullscreen(view->xdg_toplevel.xdg_toplevel, false);
+
+    if (view->xdg_toplevel.tile.node != NULL) {
+      nora_layout_retile_view(view);
+      nora_layout_arrange(workspace);
+    } else if (view->xdg_toplevel.maximized) {
+      view->xdg_toplevel.maximized = false;
+      nora_view_set_maximized(view, true);
+    } else {
+      nora_view_restore_box(view);
+    }
+  }
+
+  nora_tree_container_update_bounds(view->container);
+  wlr_output_schedule_frame(tree_output->output->wlr_output);
+}
+
+static void nora_view_apply_maximized(struct nora_view *view) {
+  struct wlr_box box;
+  nora_output_usable_box(view->container->workspace->output->output, &box);
+
+  wlr_scene_node_set_position(&view->xdg_toplevel.scene_tree->node, box.x,
+                              box.y);
+  wlr_xdg_toplevel_set_size(view->xdg_toplevel.xdg_toplevel, box.width,
+                            box.height);
+}
+
+void nora_view_set_maximized(struct nora_view *view, bool maximized) {
+  assert(view->kind == NORA_VIEW_KIND_XDG_TOPLEVEL);
+
+  struct nora_tree_workspace *workspace = view->container->workspace;
+  if (workspace == NULL || workspace->output->output == NULL ||
+      view->xdg_toplevel.fullscreen ||
+      view->xdg_toplevel.tile.node != NULL ||
+      view->xdg_toplevel.maximized == maximized) {
+    wlr_xdg_surface_schedule_configure(view->xdg_toplevel.xdg_toplevel->base);
+    return;
+  }
+
+  if (maximized) {
+    nora_view_save_box(view);
+    nora_view_apply_maximized(view);
+  } else {
+    nora_view_restore_box(view);
+  }
+
+  wlr_xdg_toplevel_set_maximized(view->xdg_toplevel.xdg_toplevel, maximized);
+  view->xdg_toplevel.maximized = maximized;
+
+  nora_tree_container_update_bounds(view->container);
+}
+
 static void on_xdg_toplevel_request_maximize(struct wl_listener *listener,
                                              void *data) {
+  NORA_TRACE_FUNC();
   struct nora_view *view =
       wl_container_of(listener, view, xdg_toplevel.request_maximize);
-  wlr_xdg_surface_schedule_configure(view->xdg_toplevel.xdg_toplevel->base);
+  nora_view_set_maximized(view,
+                          view->xdg_toplevel.xdg_toplevel->requested.maximized);
 }
 
 static void on_xdg_toplevel_request_fullscreen(struct wl_listener *listener,
                                                void *data) {
+  NORA_TRACE_FUNC();
   struct nora_view *view =
       wl_container_of(listener, view, xdg_toplevel.request_fullscreen);
-  wlr_xdg_surface_schedule_configure(view->xdg_toplevel.xdg_toplevel->base);
+  nora_view_set_fullscreen(
+      view, view->xdg_toplevel.xdg_toplevel->requested.fullscreen);
 }
 
 static void on_xdg_toplevel_title(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   struct nora_view *view =
       wl_container_of(listener, view, xdg_toplevel.set_title);
   nora_desktop_view_handle_unstable_v1_set_title(
@@ -230,49 +807,109 @@ static void on_xdg_toplevel_title(struct wl_listener *listener, void *data) {
 }
 
 static void on_xdg_toplevel_app_id(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   struct nora_view *view =
       wl_container_of(listener, view, xdg_toplevel.set_app_id);
   nora_desktop_view_handle_unstable_v1_set_app_id(
       view->view_handle, view->xdg_toplevel.xdg_toplevel->app_id);
 }
 
-static void on_xdg_popup_map(struct wl_listener *listener, void *data) {}
+static void on_xdg_popup_map(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
+  struct nora_view *view = wl_container_of(listener, view, map);
+
+  nora_tree_container_set_mapped(view->container, true);
+}
 
 static void on_xdg_popup_unmap(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   struct nora_view *view = wl_container_of(listener, view, unmap);
+
+  if (view->container != NULL) {
+    nora_tree_container_set_mapped(view->container, false);
+  }
+}
+
+static void on_xdg_popup_commit(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
+  struct nora_view *view = wl_container_of(listener, view, xdg_popup.commit);
+
+  if (view->container != NULL) {
+    nora_tree_container_update_bounds(view->container);
+  }
 }
 
 static void on_xdg_popup_reposition(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   struct nora_view *view =
       wl_container_of(listener, view, xdg_popup.reposition);
+
+  // The new position is applied by the scene, the index has to follow.
+  nora_tree_container_update_bounds(view->container);
+}
+
+static void on_xdg_popup_scene_destroy(struct wl_listener *listener,
+                                       void *data) {
+  struct nora_view *view =
+      wl_container_of(listener, view, xdg_popup.scene_destroy);
+
+  wl_list_remove(&view->xdg_popup.scene_destroy.link);
+  view->xdg_popup.scene_tree = NULL;
 }
 
 static void on_xdg_popup_destroy(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   struct nora_view *view = wl_container_of(listener, view, destroy);
+
+  nora_tree_container_destroy(view->container);
+
+  if (view->xdg_popup.scene_tree != NULL) {
+    wl_list_remove(&view->xdg_popup.scene_destroy.link);
+  }
+
+  wl_list_remove(&view->map.link);
+  wl_list_remove(&view->unmap.link);
+  wl_list_remove(&view->destroy.link);
+  wl_list_remove(&view->xdg_popup.reposition.link);
+  wl_list_remove(&view->xdg_popup.commit.link);
+
+  nora_view_destroy(view);
 }
 
 void nora_new_xdg_toplevel(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
   struct nora_server *server =
       wl_container_of(listener, server, desktop.new_xdg_toplevel);
   struct wlr_xdg_toplevel *toplevel = data;
 
-  struct nora_view *view = calloc(1, sizeof(*view));
-  view->server = server;
+  struct nora_view *view =
+      nora_view_create(server, NORA_VIEW_KIND_XDG_TOPLEVEL);
+  if (view == NULL) {
+    wlr_log(WLR_ERROR, "Out of memory for xdg toplevel");
+    wl_resource_post_no_memory(toplevel->resource);
+    return;
+  }
 
   struct nora_output *output = nora_get_current_output(server);
   view->output = output;
 
-  view->kind = NORA_VIEW_KIND_XDG_TOPLEVEL;
   view->xdg_toplevel.xdg_toplevel = toplevel;
 
+  // Without an output the view waits on a parked workspace for one.
   struct nora_tree_workspace *workspace =
-      nora_tree_root_current_workspace(server->tree_root);
+      output != NULL ? nora_tree_output_current_workspace(output->tree_output)
+                     : nora_tree_root_parked_workspace(server->tree_root);
   view->xdg_toplevel.scene_tree =
       wlr_scene_xdg_surface_create(workspace->scene_tree, toplevel->base);
   view->xdg_toplevel.scene_tree->node.data = view;
 
   view->view_handle =
       nora_desktop_view_unstable_v1_create(server->desktop.manager);
+  view->view_handle->data = view;
+
+  view->xdg_toplevel.request_hide.notify = on_view_handle_request_hide;
+  wl_signal_add(&view->view_handle->events.request_hide,
+                &view->xdg_toplevel.request_hide);
 
   view->map.notify = on_xdg_toplevel_map;
   wl_signal_add(&toplevel->base->surface->events.map, &view->map);
@@ -310,52 +947,62 @@ void nora_new_xdg_toplevel(struct wl_listener *listener, void *data) {
   view->xdg_toplevel.set_app_id.notify = on_xdg_toplevel_app_id;
   wl_signal_add(&toplevel->events.set_app_id, &view->xdg_toplevel.set_app_id);
 
-  struct nora_tree_container *container = nora_tree_container_create();
+  // commit event, keeps the hit-test index in sync with the surface size
+  view->xdg_toplevel.commit.notify = on_xdg_toplevel_commit;
+  wl_signal_add(&toplevel->base->surface->events.commit,
+                &view->xdg_toplevel.commit);
 
+  wl_list_init(&view->xdg_toplevel.tile.link);
+
+  struct nora_tree_container *container = view->container;
   container->ownable = true;
-  container->view = view;
   container->surface = toplevel->base->surface;
 
-  view->container = container;
-
   nora_tree_workspace_insert_container(workspace, container);
 
   wlr_log(WLR_INFO, "New xdg surface with title (%s)", toplevel->title);
 }
 
-void nora_new_xdg_popup(struct wl_listener *listener, void *data) {
-  struct nora_server *server =
-      wl_container_of(listener, server, desktop.new_xdg_popup);
-  struct wlr_xdg_popup *popup = data;
-
-  struct nora_view *view = calloc(1, sizeof(*view));
-  view->server = server;
-
-  struct nora_output *output = nora_get_current_output(server);
-  view->output = output;
-
-  view->kind = NORA_VIEW_KIND_XDG_POPUP;
-
-  struct nora_tree_workspace *workspace =
-      nora_tree_root_current_workspace(server->tree_root);
+static void nora_xdg_popup_create(
+    struct nora_server *server, struct wlr_xdg_popup *popup,
+    struct nora_tree_container *parent_container) {
+  struct nora_view *parent = parent_container->view;
+  struct wlr_scene_tree *parent_scene_tree;
+  switch (parent->kind) {
+  case NORA_VIEW_KIND_XDG_TOPLEVEL:
+    parent_scene_tree = parent->xdg_toplevel.scene_tree;
+    break;
+  case NORA_VIEW_KIND_XDG_POPUP:
+    parent_scene_tree = parent->xdg_popup.scene_tree;
+    break;
+  case NORA_VIEW_KIND_LAYER:
+    parent_scene_tree = parent->layer.popup_tree;
+    break;
+  default:
+    UNREACHABLE();
+  }
 
-  struct wlr_scene_tree *parent_scene_tree = workspace->scene_tree;
-  if (popup->parent != NULL) {
-    struct nora_tree_container *parent_container =
-        nora_tree_root_find_container_by_surface(server->tree_root,
-                                                 popup->parent);
-    assert(parent_container != NULL);
-    struct nora_view *parent = parent_container->view;
+  // A popup left without a scene tree cannot show children either.
+  if (parent_scene_tree == NULL) {
+    wlr_xdg_popup_destroy(popup);
+    return;
+  }
 
-    if (parent->kind == NORA_VIEW_KIND_XDG_POPUP)
-      parent_scene_tree = parent->xdg_popup.scene_tree;
-    else
-      parent_scene_tree = parent->xdg_toplevel.scene_tree;
+  struct nora_view *view = nora_view_create(server, NORA_VIEW_KIND_XDG_POPUP);
+  if (view == NULL) {
+    wlr_log(WLR_ERROR, "Out of memory for xdg popup");
+    wlr_xdg_popup_destroy(popup);
+    return;
   }
 
+  view->output = parent->output;
+
   view->xdg_popup.scene_tree =
       wlr_scene_xdg_surface_create(parent_scene_tree, popup->base);
   view->xdg_popup.scene_tree->node.data = view;
+  view->xdg_popup.scene_destroy.notify = on_xdg_popup_scene_destroy;
+  wl_signal_add(&view->xdg_popup.scene_tree->node.events.destroy,
+                &view->xdg_popup.scene_destroy);
 
   view->xdg_popup.xdg_popup = popup;
 
@@ -369,22 +1016,42 @@ void nora_new_xdg_popup(struct wl_listener *listener, void *data) {
   view->xdg_popup.reposition.notify = on_xdg_popup_reposition;
   wl_signal_add(&popup->events.reposition, &view->xdg_popup.reposition);
 
-  struct nora_tree_container *container = nora_tree_container_create();
-  struct nora_tree_container *parent_container =
-      nora_tree_root_find_container_by_surface(view->server->tree_root,
-                                               popup->parent);
-  assert(parent_container != NULL);
+  view->xdg_popup.commit.notify = on_xdg_popup_commit;
+  wl_signal_add(&popup->base->surface->events.commit, &view->xdg_popup.commit);
 
+  struct nora_tree_container *container = view->container;
   container->ownable = true;
-  container->view = view;
   container->surface = popup->base->surface;
 
-  view->container = container;
-
   nora_tree_container_insert_child(parent_container, container);
 }
 
+void nora_new_xdg_popup(struct wl_listener *listener, void *data) {
+  NORA_TRACE_FUNC();
+  struct nora_server *server =
+      wl_container_of(listener, server, desktop.new_xdg_popup);
+  struct wlr_xdg_popup *popup = data;
+
+  // Popups of layer surfaces are given their parent later on, they are
+  // created from on_layer_new_popup instead.
+  if (popup->parent == NULL) {
+    return;
+  }
+
+  struct nora_tree_container *parent_container =
+      nora_tree_root_find_container_by_surface(server->tree_root,
+                                               popup->parent);
+  // The parent was dismissed when its view could not be allocated.
+  if (parent_container == NULL) {
+    wlr_xdg_popup_destroy(popup);
+    return;
+  }
+
+  nora_xdg_popup_create(server, popup, parent_container);
+}
+
 void nora_focus_view(struct nora_view *view, struct wlr_surface *surface) {
+  NORA_TRACE_FUNC();
   /* Note: this function only deals with keyboard focus. */
   if (view == NULL) {
     return;
@@ -408,17 +1075,21 @@ void nora_focus_view(struct nora_view *view, struct wlr_surface *surface) {
     struct nora_tree_container *previous_container =
         nora_tree_root_find_container_by_surface(
             view->server->tree_root, seat->keyboard_state.focused_surface);
-    assert(previous_container != NULL);
-    struct nora_view *previous = previous_container->view;
+    /* The surface may outlive its role object, and with it its container,
+     * there is nothing left to deactivate then. */
+    struct nora_view *previous =
+        previous_container != NULL ? previous_container->view : NULL;
 
-    if (previous->kind == NORA_VIEW_KIND_XDG_TOPLEVEL &&
+    if (previous != NULL && previous->kind == NORA_VIEW_KIND_XDG_TOPLEVEL &&
         previous->xdg_toplevel.xdg_toplevel != NULL)
       wlr_xdg_toplevel_set_activated(previous->xdg_toplevel.xdg_toplevel,
                                      false);
   }
 
   if (view->kind == NORA_VIEW_KIND_XDG_POPUP) {
-    wlr_scene_node_raise_to_top(&view->xdg_popup.scene_tree->node);
+    if (view->xdg_popup.scene_tree != NULL) {
+      wlr_scene_node_raise_to_top(&view->xdg_popup.scene_tree->node);
+    }
     if (keyboard != NULL) {
       wlr_seat_keyboard_notify_enter(
           seat, view->xdg_popup.xdg_popup->base->surface, keyboard->keycodes,
@@ -434,8 +1105,18 @@ void nora_focus_view(struct nora_view *view, struct wlr_surface *surface) {
 
   assert(view->xdg_toplevel.scene_tree != NULL);
 
+  /* Focusing a hidden view, e.g. by cycling focus, brings it back. */
+  nora_view_set_hidden(view, false);
+
   /* Move the view to the front */
   wlr_scene_node_raise_to_top(&view->xdg_toplevel.scene_tree->node);
+  nora_tree_container_raise(view->container);
+
+  /* Tabbed and stacked layouts switch to the focused view. */
+  if (view->xdg_toplevel.tile.node != NULL) {
+    nora_layout_focus_view(view);
+    nora_layout_arrange(view->container->workspace);
+  }
 
   /* Activate the new surface */
   wlr_xdg_toplevel_set_activated(view->xdg_toplevel.xdg_toplevel, true);
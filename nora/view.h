@@ -37,27 +37,86 @@ struct nora_view {
 
       struct wl_listener set_title;
       struct wl_listener set_app_id;
+      struct wl_listener commit;
+      struct wl_listener request_hide;
 
+      // Floating geometry in layout coordinates, restored when leaving
+      // fullscreen or maximized.
       struct wlr_box box;
+      bool fullscreen;
+      bool maximized;
+      // Hidden through the desktop management protocol.
+      bool hidden;
+      bool suspended;
+
+      /* Interactive resize, at most one configure is in flight at a time and
+       * the view is only moved once the client commits a buffer for it.
+       */
+      struct {
+        uint32_t serial; // in-flight configure, 0 if none
+        uint32_t edges;
+        struct wlr_box inflight; // layout box requested by serial
+        struct wlr_box pending;  // latest box requested by the grab
+        bool has_pending;
+      } resize;
+
+      /* Tiling, see layout.h. The layout box lives in the node. */
+      struct {
+        struct nora_layout_node *node; // NULL while floating
+        struct nora_layout_transaction *transaction;
+        struct wl_list link; // nora_layout_transaction::views
+        // Last size sent to the client.
+        int32_t width, height;
+        // Configure the transaction waits for, 0 once acked.
+        uint32_t serial;
+        bool waiting;
+        // Copy of the buffers shown until the transaction is applied, next
+        // to scene_tree.
+        struct wlr_scene_tree *saved;
+      } tile;
     } xdg_toplevel;
 
     struct {
       struct wlr_xdg_popup *xdg_popup;
+      // NULL once destroyed along with the scene tree of the parent, the
+      // popup may outlive it.
       struct wlr_scene_tree *scene_tree;
 
       struct wl_listener reposition;
+      struct wl_listener commit;
+      struct wl_listener scene_destroy;
     } xdg_popup;
 
     struct {
       struct wlr_layer_surface_v1 *surface;
       struct wlr_scene_layer_surface_v1 *scene_tree;
+      // Holds the popups of the surface, in the output's popups_tree and
+      // kept at the position of scene_tree.
+      struct wlr_scene_tree *popup_tree;
 
       struct wl_listener new_popup;
       struct wl_listener commit;
+
+      // State the output was last arranged with, commits which leave it
+      // untouched do not arrange the output again.
+      struct nora_layer_state {
+        uint32_t layer;
+        uint32_t anchor;
+        int32_t exclusive_zone;
+        int32_t margin_top, margin_right, margin_bottom, margin_left;
+        uint32_t desired_width, desired_height;
+      } arranged;
     } layer;
   };
 };
 
+// Logs the live views per kind and the pools backing views and containers.
+void nora_view_log_stats(struct nora_server *server);
+
+// Places the layer surfaces of the output and recomputes the area left for
+// views by their exclusive zones.
+void nora_arrange_layers(struct nora_output *output);
+
 // listener
 void nora_new_layer_surface(struct wl_listener *listener, void *data);
 
@@ -73,4 +132,20 @@ struct nora_view *nora_view_at(struct nora_server *server, double lx, double ly,
 
 void nora_focus_view(struct nora_view *view, struct wlr_surface *surface);
 
+void nora_view_set_hidden(struct nora_view *view, bool hidden);
+// Tells the toplevel whether it is shown, hidden views are suspended and get
+// no frame callbacks.
+void nora_view_update_suspended(struct nora_view *view);
+
+void nora_view_set_fullscreen(struct nora_view *view, bool fullscreen);
+void nora_view_set_maximized(struct nora_view *view, bool maximized);
+
+// Requests the toplevel to take the given layout box, edges are the edges
+// being dragged and stay anchored opposite of them.
+void nora_view_resize(struct nora_view *view, struct wlr_box box,
+                      uint32_t edges);
+// Makes sure the last requested box reaches the client, called when the grab
+// ends.
+void nora_view_flush_resize(struct nora_view *view);
+
 #endif // NORA_VIEW_H_
@@ -0,0 +1,274 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <systemd/sd-bus.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char usage[] =
+    "Usage: nora-proxies-bench [options]\n"
+    "\n"
+    "Measures the round trip of a D-Bus method call that nora-proxies\n"
+    "forwards to the compositor, from the caller's point of view. Calls\n"
+    "org.nora.Proxies.Sync, which replies once the compositor has answered a\n"
+    "wl_display.sync. Talks to the running nora-proxies unless both\n"
+    "--compositor and --proxies are given, then runs its own nora on the\n"
+    "headless backend. Skipped if there is no user bus.\n"
+    "\n"
+    "  -h, --help                Show this help message.\n"
+    "  -n, --calls <n>           Calls to measure. Default: 10000\n"
+    "  -c, --compositor <path>   Compositor to run.\n"
+    "  -p, --proxies <path>      nora-proxies to run against it.\n";
+
+struct bench {
+  const char *compositor;
+  const char *proxies;
+  char runtime_dir[64];
+  pid_t compositor_pid;
+  pid_t proxies_pid;
+};
+
+static int64_t now_nsec(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int compare_int64(const void *a, const void *b) {
+  int64_t x = *(const int64_t *)a;
+  int64_t y = *(const int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static pid_t bench_spawn(const char *path, bool headless) {
+  pid_t pid = fork();
+  if (pid != 0) {
+    if (pid < 0) {
+      perror("fork failed");
+    }
+    return pid;
+  }
+
+  if (headless) {
+    setenv("WLR_BACKENDS", "headless", 1);
+    setenv("WLR_RENDERER", "pixman", 1);
+    setenv("WLR_HEADLESS_OUTPUTS", "1", 1);
+    setenv("WLR_LIBINPUT_NO_DEVICES", "1", 1);
+    unsetenv("WAYLAND_DISPLAY");
+    unsetenv("DISPLAY");
+  }
+
+  // Both log every event, keep the report readable.
+  int null = open("/dev/null", O_WRONLY);
+  if (null >= 0) {
+    dup2(null, STDERR_FILENO);
+    dup2(null, STDOUT_FILENO);
+  }
+
+  execlp(path, path, (char *)NULL);
+  _exit(127);
+}
+
+static bool bench_exited(pid_t *pid, const char *path) {
+  if (*pid > 0 && waitpid(*pid, NULL, WNOHANG) == *pid) {
+    fprintf(stderr, "%s exited during startup\n", path);
+    *pid = 0;
+    return true;
+  }
+
+  return false;
+}
+
+static void bench_kill(pid_t *pid) {
+  if (*pid > 0) {
+    kill(*pid, SIGTERM);
+    waitpid(*pid, NULL, 0);
+    *pid = 0;
+  }
+}
+
+static int bench_call_sync(sd_bus *bus, uint64_t timeout_usec) {
+  sd_bus_message *call = NULL;
+  int ret = sd_bus_message_new_method_call(bus, &call, "org.nora.proxies",
+                                           "/org/nora", "org.nora.Proxies",
+                                           "Sync");
+  if (0 > ret) {
+    return ret;
+  }
+
+  ret = sd_bus_call(bus, call, timeout_usec, NULL, NULL);
+  sd_bus_message_unref(call);
+  return ret;
+}
+
+static bool bench_start(struct bench *bench, sd_bus *bus) {
+  snprintf(bench->runtime_dir, sizeof(bench->runtime_dir),
+           "/tmp/nora-proxies-bench-XXXXXX");
+  if (mkdtemp(bench->runtime_dir) == NULL) {
+    perror("failed to create runtime directory");
+    return false;
+  }
+
+  // A fresh runtime directory makes the compositor pick wayland-0, which is
+  // where nora-proxies connects to.
+  setenv("XDG_RUNTIME_DIR", bench->runtime_dir, 1);
+
+  bench->compositor_pid = bench_spawn(bench->compositor, true);
+  if (bench->compositor_pid < 0) {
+    return false;
+  }
+
+  char socket[128];
+  snprintf(socket, sizeof(socket), "%s/wayland-0", bench->runtime_dir);
+  struct stat st;
+  for (int i = 0; stat(socket, &st) != 0; ++i) {
+    if (bench_exited(&bench->compositor_pid, bench->compositor)) {
+      return false;
+    }
+    if (i == 500) {
+      fprintf(stderr, "%s did not create its socket\n", bench->compositor);
+      return false;
+    }
+    usleep(10000);
+  }
+
+  bench->proxies_pid = bench_spawn(bench->proxies, false);
+  if (bench->proxies_pid < 0) {
+    return false;
+  }
+
+  // Answers once nora-proxies owns its name and is connected to nora.
+  for (int i = 0; bench_call_sync(bus, 100000) < 0; ++i) {
+    if (bench_exited(&bench->proxies_pid, bench->proxies)) {
+      return false;
+    }
+    if (i == 50) {
+      fprintf(stderr, "%s did not answer\n", bench->proxies);
+      return false;
+    }
+    usleep(100000);
+  }
+
+  return true;
+}
+
+static void bench_stop(struct bench *bench) {
+  bench_kill(&bench->proxies_pid);
+  bench_kill(&bench->compositor_pid);
+
+  if (bench->runtime_dir[0] == '\0') {
+    return;
+  }
+
+  char socket[128];
+  snprintf(socket, sizeof(socket), "%s/wayland-0", bench->runtime_dir);
+  unlink(socket);
+  snprintf(socket, sizeof(socket), "%s/wayland-0.lock", bench->runtime_dir);
+  unlink(socket);
+  rmdir(bench->runtime_dir);
+}
+
+int main(int argc, char **argv) {
+  struct bench bench = {0};
+  size_t count = 10000;
+
+  static const struct option long_options[] = {
+      {"help", no_argument, NULL, 'h'},
+      {"calls", required_argument, NULL, 'n'},
+      {"compositor", required_argument, NULL, 'c'},
+      {"proxies", required_argument, NULL, 'p'},
+      {0, 0, 0, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "hn:c:p:", long_options, NULL)) != -1) {
+    switch (c) {
+    case 'n':
+      count = strtoul(optarg, NULL, 10);
+      break;
+    case 'c':
+      bench.compositor = optarg;
+      break;
+    case 'p':
+      bench.proxies = optarg;
+      break;
+    case 'h':
+      printf("%s", usage);
+      return 0;
+    default:
+      fprintf(stderr, "%s", usage);
+      return 1;
+    }
+  }
+
+  if (count == 0 || (bench.compositor == NULL) != (bench.proxies == NULL)) {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+
+  // The user bus lives in the real runtime directory, not in ours.
+  const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+  if (getenv("DBUS_SESSION_BUS_ADDRESS") == NULL && runtime_dir != NULL) {
+    char *address = NULL;
+    if (asprintf(&address, "unix:path=%s/bus", runtime_dir) >= 0) {
+      setenv("DBUS_SESSION_BUS_ADDRESS", address, 1);
+      free(address);
+    }
+  }
+
+  sd_bus *bus = NULL;
+  int ret = sd_bus_default_user(&bus);
+  if (0 > ret) {
+    // Exit code 77 makes meson report the benchmark as skipped.
+    fprintf(stderr, "could not connect to dbus: (%s), skipped\n",
+            strerror(-ret));
+    return 77;
+  }
+
+  int64_t *samples = calloc(count, sizeof(*samples));
+  if (samples == NULL) {
+    fprintf(stderr, "out of memory\n");
+    sd_bus_unref(bus);
+    return 1;
+  }
+
+  int status = 1;
+  if (bench.compositor != NULL && !bench_start(&bench, bus)) {
+    goto out;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    int64_t start = now_nsec();
+    ret = bench_call_sync(bus, 0);
+    samples[i] = now_nsec() - start;
+
+    if (0 > ret) {
+      fprintf(stderr, "call %zu to org.nora.Proxies.Sync failed: (%s)\n", i,
+              strerror(-ret));
+      goto out;
+    }
+  }
+
+  qsort(samples, count, sizeof(*samples), compare_int64);
+  printf("%zu calls to org.nora.Proxies.Sync: p50 %.1fus, p90 %.1fus, "
+         "p99 %.1fus, max %.1fus\n",
+         count, samples[(count - 1) * 50 / 100] / 1000.0,
+         samples[(count - 1) * 90 / 100] / 1000.0,
+         samples[(count - 1) * 99 / 100] / 1000.0,
+         samples[count - 1] / 1000.0);
+  status = 0;
+
+out:
+  bench_stop(&bench);
+  free(samples);
+  sd_bus_unref(bus);
+  return status;
+}
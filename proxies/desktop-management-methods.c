@@ -8,5 +8,5 @@ int nora_proxy_view_method_hide(sd_bus_message *m, void *userdata, sd_bus_error
 
   nora_desktop_view_v1_hide(view->inner);
 
-  return 1;
+  return nora_proxy_reply_after_sync(view->state->proxy, m);
 }
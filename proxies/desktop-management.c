@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <systemd/sd-bus.h>
 #include <wayland-util.h>
 
@@ -8,16 +9,19 @@
 #include "nora-desktop-management-unstable-v1-protocol.h"
 #include "proxy.h"
 
+static const char *const view_properties[] = {
+    [NORA_PROXY_VIEW_TITLE] = "Title",
+    [NORA_PROXY_VIEW_APP_ID] = "AppId",
+};
+
 static void on_view_app_id(void *data,
                            struct nora_desktop_view_v1 *nora_desktop_view_v1,
                            const char *app_id) {
   struct nora_proxy_view *view = data;
 
-  if (!view->app_id) {
-    free(view->app_id);
+  if (nora_proxy_set_string(&view->app_id, app_id)) {
+    nora_proxy_object_changed(&view->object, NORA_PROXY_VIEW_APP_ID);
   }
-
-  view->app_id = strdup(app_id);
 }
 
 static void on_view_title(void *data,
@@ -25,18 +29,22 @@ static void on_view_title(void *data,
                           const char *title) {
   struct nora_proxy_view *view = data;
 
-  if (!view->title) {
-    free(view->title);
+  if (nora_proxy_set_string(&view->title, title)) {
+    nora_proxy_object_changed(&view->object, NORA_PROXY_VIEW_TITLE);
   }
-
-  view->title = strdup(title);
 }
 
 static void on_view_destroy(void *data,
                             struct nora_desktop_view_v1 *nora_desktop_view_v1) {
   struct nora_proxy_view *view = data;
 
-  fprintf(stdout, "got on_view_destroy\n");
+  nora_proxy_object_remove(view->state->proxy, &view->object);
+  wl_list_remove(&view->link);
+
+  nora_desktop_view_v1_destroy(view->inner);
+  free(view->app_id);
+  free(view->title);
+  free(view);
 }
 
 static void on_view_hidden(void *data,
@@ -57,6 +65,14 @@ static void on_view_workspace(void *data,
   struct nora_proxy_view *view = data;
 }
 
+static void on_view_done(void *data,
+                         struct nora_desktop_view_v1 *nora_desktop_view_v1) {
+  struct nora_proxy_view *view = data;
+
+  // The attributes sent before are consistent, publish them in one go.
+  nora_proxy_object_flush(view->state->proxy, &view->object);
+}
+
 static struct nora_desktop_view_v1_listener view_listener = {
     .app_id = on_view_app_id,
     .title = on_view_title,
@@ -64,6 +80,7 @@ static struct nora_desktop_view_v1_listener view_listener = {
     .hidden = on_view_hidden,
     .kind = on_view_kind,
     .workspace = on_view_workspace,
+    .done = on_view_done,
 };
 
 static void
@@ -75,20 +92,19 @@ on_desktop_view(void *data,
   struct nora_proxy_view *view = calloc(1, sizeof(*view));
   view->state = state;
   view->inner = view_handle;
+  nora_proxy_object_init(&view->object, "org.nora.View", view_properties);
 
-  char *path = calloc(1, 256);
-  sprintf(path, "/org/nora/view/_%d", wl_list_length(&state->views));
-
-  view->object_path = path;
-
-  int ret =
-      sd_bus_add_object_vtable(state->proxy->bus, NULL, path, "org.nora.View",
-                               nora_proxy_view_vtable, view);
+  int ret = nora_proxy_object_add(state->proxy, &view->object,
+                                  NORA_PROXY_OBJECT_ROOT "/view",
+                                  state->next_view_id++,
+                                  nora_proxy_view_vtable, view);
   if (0 > ret) {
-    fprintf(stderr, "could not add output object: %s\n", strerror(-ret));
+    fprintf(stderr, "could not add view object: %s\n", strerror(-ret));
     exit(EXIT_FAILURE);
   }
 
+  wl_list_insert(state->views.prev, &view->link);
+  // Announced on its first done, along with its initial attributes.
   nora_desktop_view_v1_add_listener(view_handle, &view_listener, view);
 }
 
@@ -99,9 +115,16 @@ on_desktop_workspace(void *data,
   fprintf(stdout, "got workspace!\n");
 }
 
+static void
+on_desktop_done(void *data,
+                struct nora_desktop_manager_v1 *nora_desktop_manager_v1) {
+  fprintf(stdout, "got initial desktop state\n");
+}
+
 static const struct nora_desktop_manager_v1_listener manager_listener = {
     .view = on_desktop_view,
     .workspace = on_desktop_workspace,
+    .done = on_desktop_done,
 };
 
 void *nora_proxy_desktop_management_create(struct nora_proxy *proxy) {
@@ -112,7 +135,7 @@ void *nora_proxy_desktop_management_create(struct nora_proxy *proxy) {
   wl_list_init(&state->views);
   wl_list_init(&state->workspaces);
 
-  nora_proxy_bind(proxy, nora_desktop_manager_v1_interface, 1);
+  nora_proxy_bind(proxy, nora_desktop_manager_v1_interface, 2);
 
   return state;
 }
@@ -120,7 +143,7 @@ void *nora_proxy_desktop_management_create(struct nora_proxy *proxy) {
 void nora_proxy_desktop_management_configure(
     struct nora_proxy_desktop_management_state *state) {
   struct nora_desktop_manager_v1 *manager =
-      nora_proxy_extract(state->proxy, nora_desktop_manager_v1_interface, 1);
+      nora_proxy_extract(state->proxy, nora_desktop_manager_v1_interface, 2);
 
   nora_desktop_manager_v1_add_listener(manager, &manager_listener, state);
 }
@@ -6,6 +6,12 @@
 
 struct nora_proxy_workspace {};
 
+// Bits of nora_proxy_object::changed, see nora_proxy_view_properties.
+enum nora_proxy_view_property {
+  NORA_PROXY_VIEW_TITLE,
+  NORA_PROXY_VIEW_APP_ID,
+};
+
 struct nora_proxy_view {
   struct wl_list link;
 
@@ -13,7 +19,7 @@ struct nora_proxy_view {
 
   struct nora_proxy_desktop_management_state *state;
 
-  char *object_path;
+  struct nora_proxy_object object;
 
   char *app_id;
   char *title;
@@ -24,6 +30,9 @@ struct nora_proxy_desktop_management_state {
 
   struct wl_list workspaces;
   struct wl_list views;
+
+  // Object path ids are handed out once, never reused.
+  uint32_t next_view_id;
 };
 
 void *nora_proxy_desktop_management_create(struct nora_proxy *proxy);
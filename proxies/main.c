@@ -23,21 +23,11 @@ int main(void) {
   nora_proxy_output_management_configure(output_management_state);
   nora_proxy_desktop_management_configure(desktop_management_state);
 
-  for (;;) {
-    int ret = wl_display_roundtrip(proxy->display);
-    if (ret < 0) {
-      fprintf(stderr, "could not perform roundtrip: %s\n", strerror(-ret));
-      return ret;
-    }
-
-    ret = sd_bus_process(proxy->bus, NULL);
-    if (ret < 0) {
-      fprintf(stderr, "Failed to process bus: %s\n", strerror(-ret));
-      return ret;
-    }
-
-    /* ... handle other events if needed ... */
+  int ret = nora_proxy_run(proxy);
+  if (ret < 0) {
+    fprintf(stderr, "proxy stopped: %s\n", strerror(-ret));
   }
 
   nora_proxy_destroy(proxy);
+  return ret < 0 ? 1 : 0;
 }
@@ -10,76 +10,100 @@
 #include "proxy.h"
 #include "wlr-output-management-unstable-v1-client-protocol.h"
 
+static const char *const output_properties[] = {
+    [NORA_PROXY_OUTPUT_NAME] = "Name",
+    [NORA_PROXY_OUTPUT_DESCRIPTION] = "Description",
+    [NORA_PROXY_OUTPUT_POSITION] = "Position",
+    [NORA_PROXY_OUTPUT_PHYSICAL_SIZE] = "PhysicalSize",
+    [NORA_PROXY_OUTPUT_ENABLED] = "Enabled",
+    [NORA_PROXY_OUTPUT_TRANSFORM] = "Transform",
+    [NORA_PROXY_OUTPUT_SCALE] = "Scale",
+    [NORA_PROXY_OUTPUT_MAKE] = "Make",
+    [NORA_PROXY_OUTPUT_SERIAL_NUMBER] = "SerialNumber",
+    [NORA_PROXY_OUTPUT_MODEL] = "Model",
+};
+
+// Head events only record what changed, the manager's done event flushes it.
+static void set_string(struct nora_proxy_output *output, char **field,
+                       const char *value,
+                       enum nora_proxy_output_property property) {
+  if (nora_proxy_set_string(field, value)) {
+    nora_proxy_object_changed(&output->object, property);
+  }
+}
+
+static void set_int(struct nora_proxy_output *output, int32_t *field,
+                    int32_t value, enum nora_proxy_output_property property) {
+  if (*field != value) {
+    *field = value;
+    nora_proxy_object_changed(&output->object, property);
+  }
+}
+
 static void on_head_name(void *data, struct zwlr_output_head_v1 *head,
                          const char *name) {
   struct nora_proxy_output *output = data;
-
-  output->name = calloc(1, strlen(name));
-  strcpy(output->name, name);
+  set_string(output, &output->name, name, NORA_PROXY_OUTPUT_NAME);
 }
 
 static void on_head_description(void *data, struct zwlr_output_head_v1 *head,
                                 const char *description) {
   struct nora_proxy_output *output = data;
-
-  output->description = calloc(1, strlen(description));
-  strcpy(output->description, description);
+  set_string(output, &output->description, description,
+             NORA_PROXY_OUTPUT_DESCRIPTION);
 }
 
 static void on_head_physical_size(void *data, struct zwlr_output_head_v1 *head,
                                   int32_t w, int32_t h) {
   struct nora_proxy_output *output = data;
-  output->physical_size[0] = w;
-  output->physical_size[1] = h;
+  set_int(output, &output->physical_size[0], w,
+          NORA_PROXY_OUTPUT_PHYSICAL_SIZE);
+  set_int(output, &output->physical_size[1], h,
+          NORA_PROXY_OUTPUT_PHYSICAL_SIZE);
 }
 
 static void on_head_position(void *data, struct zwlr_output_head_v1 *head,
                              int32_t x, int32_t y) {
   struct nora_proxy_output *output = data;
-  output->position[0] = x;
-  output->position[1] = y;
+  set_int(output, &output->position[0], x, NORA_PROXY_OUTPUT_POSITION);
+  set_int(output, &output->position[1], y, NORA_PROXY_OUTPUT_POSITION);
 }
 
 static void on_head_make(void *data, struct zwlr_output_head_v1 *head,
                          const char *make) {
   struct nora_proxy_output *output = data;
-
-  output->make = calloc(1, strlen(make));
-  strcpy(output->make, make);
+  set_string(output, &output->make, make, NORA_PROXY_OUTPUT_MAKE);
 }
 
 static void on_head_model(void *data, struct zwlr_output_head_v1 *head,
                           const char *model) {
   struct nora_proxy_output *output = data;
-
-  output->model = calloc(1, strlen(model));
-  strcpy(output->model, model);
+  set_string(output, &output->model, model, NORA_PROXY_OUTPUT_MODEL);
 }
 
 static void on_head_serial_number(void *data, struct zwlr_output_head_v1 *head,
                                   const char *serial_number) {
   struct nora_proxy_output *output = data;
-
-  output->serial_number = calloc(1, strlen(serial_number));
-  strcpy(output->serial_number, serial_number);
+  set_string(output, &output->serial_number, serial_number,
+             NORA_PROXY_OUTPUT_SERIAL_NUMBER);
 }
 
 static void on_head_enabled(void *data, struct zwlr_output_head_v1 *head,
                             int32_t enabled) {
   struct nora_proxy_output *output = data;
-  output->enabled = enabled;
+  set_int(output, &output->enabled, enabled, NORA_PROXY_OUTPUT_ENABLED);
 }
 
 static void on_head_transform(void *data, struct zwlr_output_head_v1 *head,
                               int32_t transform) {
   struct nora_proxy_output *output = data;
-  output->transform = transform;
+  set_int(output, &output->transform, transform, NORA_PROXY_OUTPUT_TRANSFORM);
 }
 
 static void on_head_scale(void *data, struct zwlr_output_head_v1 *head,
                           int32_t scale) {
   struct nora_proxy_output *output = data;
-  output->scale = scale;
+  set_int(output, &output->scale, scale, NORA_PROXY_OUTPUT_SCALE);
 }
 
 // TODO: Implement this lot.
@@ -92,7 +116,20 @@ static void on_head_current_mode(void *data, struct zwlr_output_head_v1 *head,
 static void on_head_mode(void *data, struct zwlr_output_head_v1 *head,
                          struct zwlr_output_mode_v1 *mode) {}
 
-static void on_head_finished(void *data, struct zwlr_output_head_v1 *head) {}
+static void on_head_finished(void *data, struct zwlr_output_head_v1 *head) {
+  struct nora_proxy_output *output = data;
+
+  nora_proxy_object_remove(output->state->proxy, &output->object);
+  wl_list_remove(&output->link);
+
+  zwlr_output_head_v1_release(head);
+  free(output->name);
+  free(output->description);
+  free(output->make);
+  free(output->serial_number);
+  free(output->model);
+  free(output);
+}
 
 static const struct zwlr_output_head_v1_listener head_listener = {
     .name = on_head_name,
@@ -118,13 +155,15 @@ on_manager_head(void *data,
   struct nora_proxy_output_management_state *state = data;
 
   struct nora_proxy_output *output = calloc(1, sizeof(*output));
-
-  char *path = calloc(1, 128);
-  sprintf(path, "/org/nora/output/_%d", wl_list_length(&state->outputs));
-
-  int ret =
-      sd_bus_add_object_vtable(state->proxy->bus, NULL, path, "org.nora.Output",
-                               nora_proxy_output_vtable, output);
+  output->state = state;
+  output->head = head;
+  nora_proxy_object_init(&output->object, "org.nora.Output",
+                         output_properties);
+
+  int ret = nora_proxy_object_add(state->proxy, &output->object,
+                                  NORA_PROXY_OBJECT_ROOT "/output",
+                                  state->next_output_id++,
+                                  nora_proxy_output_vtable, output);
   if (0 > ret) {
     fprintf(stderr, "could not add output object: %s\n", strerror(-ret));
     exit(EXIT_FAILURE);
@@ -139,7 +178,16 @@ on_manager_finished(void *data,
                     struct zwlr_output_manager_v1 *zwlr_output_manager_v1) {}
 
 static void on_manager_done(void *data, struct zwlr_output_manager_v1 *manager,
-                            uint32_t serial) {}
+                            uint32_t serial) {
+  struct nora_proxy_output_management_state *state = data;
+
+  /* The heads are consistent again, publish what changed since the last
+   * done as one signal per output. */
+  struct nora_proxy_output *output;
+  wl_list_for_each(output, &state->outputs, link) {
+    nora_proxy_object_flush(state->proxy, &output->object);
+  }
+}
 
 static const struct zwlr_output_manager_v1_listener output_manager_listener = {
     .head = on_manager_head,
@@ -9,9 +9,27 @@
 
 #include "proxy.h"
 
+// Bits of nora_proxy_object::changed, see nora_proxy_output_properties.
+enum nora_proxy_output_property {
+  NORA_PROXY_OUTPUT_NAME,
+  NORA_PROXY_OUTPUT_DESCRIPTION,
+  NORA_PROXY_OUTPUT_POSITION,
+  NORA_PROXY_OUTPUT_PHYSICAL_SIZE,
+  NORA_PROXY_OUTPUT_ENABLED,
+  NORA_PROXY_OUTPUT_TRANSFORM,
+  NORA_PROXY_OUTPUT_SCALE,
+  NORA_PROXY_OUTPUT_MAKE,
+  NORA_PROXY_OUTPUT_SERIAL_NUMBER,
+  NORA_PROXY_OUTPUT_MODEL,
+};
+
 struct nora_proxy_output {
   struct wl_list link;
 
+  struct nora_proxy_output_management_state *state;
+  struct zwlr_output_head_v1 *head;
+  struct nora_proxy_object object;
+
   char *name;
   char *description;
 
@@ -29,6 +47,9 @@ struct nora_proxy_output {
 struct nora_proxy_output_management_state {
   struct nora_proxy *proxy;
   struct wl_list outputs;
+
+  // Object path ids are handed out once, never reused.
+  uint32_t next_output_id;
 };
 
 void *nora_proxy_output_management_create(struct nora_proxy *proxy);
@@ -65,7 +86,7 @@ static const sd_bus_vtable nora_proxy_output_vtable[] = {
                     SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
     SD_BUS_PROPERTY("Scale", "i", NULL,
                     offsetof(struct nora_proxy_output, scale),
-                    SD_BUS_VTABLE_PROPERTY_CONST),
+                    SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
     SD_BUS_PROPERTY("Make", "s", NULL, offsetof(struct nora_proxy_output, make),
                     SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
     SD_BUS_PROPERTY("SerialNumber", "s", NULL,
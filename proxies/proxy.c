@@ -1,7 +1,14 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
 #include <systemd/sd-bus-protocol.h>
 #include <systemd/sd-bus.h>
 #include <wayland-client-core.h>
@@ -37,6 +44,49 @@ static const struct wl_registry_listener registry_listener = {
     .global_remove = registry_handle_global_remove,
 };
 
+static void sync_handle_done(void *data, struct wl_callback *callback,
+                             uint32_t serial) {
+  sd_bus_message *message = data;
+
+  int ret = sd_bus_reply_method_return(message, "");
+  if (0 > ret) {
+    fprintf(stderr, "could not reply to %s: (%s)\n",
+            sd_bus_message_get_member(message), strerror(-ret));
+  }
+
+  sd_bus_message_unref(message);
+  wl_callback_destroy(callback);
+}
+
+static const struct wl_callback_listener sync_listener = {
+    .done = sync_handle_done,
+};
+
+int nora_proxy_reply_after_sync(struct nora_proxy *proxy,
+                                sd_bus_message *message) {
+  struct wl_callback *callback = wl_display_sync(proxy->display);
+  if (callback == NULL) {
+    return -ENOMEM;
+  }
+
+  wl_callback_add_listener(callback, &sync_listener,
+                           sd_bus_message_ref(message));
+  // Replied to later, from sync_handle_done.
+  return 1;
+}
+
+static int proxy_method_sync(sd_bus_message *m, void *userdata,
+                             sd_bus_error *error) {
+  struct nora_proxy *proxy = userdata;
+  return nora_proxy_reply_after_sync(proxy, m);
+}
+
+static const sd_bus_vtable proxy_vtable[] = {
+    SD_BUS_VTABLE_START(0),
+    SD_BUS_METHOD("Sync", "", "", proxy_method_sync,
+                  SD_BUS_VTABLE_UNPRIVILEGED),
+    SD_BUS_VTABLE_END};
+
 struct nora_proxy *nora_proxy_create() {
   struct nora_proxy *proxy = calloc(1, sizeof(*proxy));
 
@@ -48,6 +98,8 @@ struct nora_proxy *nora_proxy_create() {
     exit(1);
   }
 
+  wl_list_init(&proxy->dirty);
+
   proxy->registry = wl_display_get_registry(proxy->display);
 
   wl_registry_add_listener(proxy->registry, &registry_listener, proxy);
@@ -64,6 +116,21 @@ struct nora_proxy *nora_proxy_create() {
     exit(1);
   }
 
+  /* Lets clients fetch every view and output with one GetManagedObjects and
+   * follow InterfacesAdded/Removed afterwards. */
+  ret = sd_bus_add_object_manager(proxy->bus, NULL, NORA_PROXY_OBJECT_ROOT);
+  if (0 > ret) {
+    fprintf(stderr, "could not add object manager: (%s)", strerror(-ret));
+    exit(1);
+  }
+
+  ret = sd_bus_add_object_vtable(proxy->bus, NULL, NORA_PROXY_OBJECT_ROOT,
+                                 "org.nora.Proxies", proxy_vtable, proxy);
+  if (0 > ret) {
+    fprintf(stderr, "could not add proxy object: (%s)", strerror(-ret));
+    exit(1);
+  }
+
   printf("is trusted: %d\n", sd_bus_is_trusted(proxy->bus));
   printf("is anonymous: %d\n", sd_bus_is_anonymous(proxy->bus));
 
@@ -125,6 +192,259 @@ void nora_proxy_flush(struct nora_proxy *proxy) {
   wl_display_roundtrip(proxy->display);
 }
 
+void nora_proxy_object_init(struct nora_proxy_object *object,
+                            const char *interface,
+                            const char *const *properties) {
+  wl_list_init(&object->dirty_link);
+  object->interface = interface;
+  object->properties = properties;
+  object->changed = 0;
+}
+
+void nora_proxy_object_finish(struct nora_proxy_object *object) {
+  wl_list_remove(&object->dirty_link);
+  wl_list_init(&object->dirty_link);
+  sd_bus_slot_unref(object->slot);
+  object->slot = NULL;
+  free(object->path);
+  object->path = NULL;
+}
+
+int nora_proxy_object_add(struct nora_proxy *proxy,
+                          struct nora_proxy_object *object, const char *prefix,
+                          uint32_t id, const sd_bus_vtable *vtable,
+                          void *userdata) {
+  if (asprintf(&object->path, "%s/_%" PRIu32, prefix, id) < 0) {
+    object->path = NULL;
+    return -ENOMEM;
+  }
+
+  int ret = sd_bus_add_object_vtable(proxy->bus, &object->slot, object->path,
+                                     object->interface, vtable, userdata);
+  if (0 > ret) {
+    return ret;
+  }
+
+  return 0;
+}
+
+void nora_proxy_object_remove(struct nora_proxy *proxy,
+                              struct nora_proxy_object *object) {
+  if (object->announced) {
+    const char *interfaces[] = {object->interface, NULL};
+    int ret = sd_bus_emit_interfaces_removed_strv(
+        proxy->bus, object->path, (char **)interfaces);
+    if (0 > ret) {
+      fprintf(stderr, "could not remove %s: (%s)\n", object->path,
+              strerror(-ret));
+    }
+  }
+
+  nora_proxy_object_finish(object);
+}
+
+void nora_proxy_object_changed(struct nora_proxy_object *object,
+                               uint32_t property) {
+  object->changed |= 1u << property;
+}
+
+void nora_proxy_object_flush(struct nora_proxy *proxy,
+                             struct nora_proxy_object *object) {
+  if ((object->changed == 0 && object->announced) ||
+      !wl_list_empty(&object->dirty_link)) {
+    return;
+  }
+
+  wl_list_insert(proxy->dirty.prev, &object->dirty_link);
+}
+
+void nora_proxy_emit_changes(struct nora_proxy *proxy) {
+  struct nora_proxy_object *object, *tmp;
+  wl_list_for_each_safe(object, tmp, &proxy->dirty, dirty_link) {
+    wl_list_remove(&object->dirty_link);
+    wl_list_init(&object->dirty_link);
+
+    char *names[33];
+    size_t count = 0;
+    for (uint32_t i = 0; i < 32; ++i) {
+      if (object->changed & (1u << i)) {
+        names[count++] = (char *)object->properties[i];
+      }
+    }
+    names[count] = NULL;
+    object->changed = 0;
+
+    if (object->path == NULL) {
+      continue;
+    }
+
+    if (!object->announced) {
+      // InterfacesAdded carries every property, changed or not.
+      int ret = sd_bus_emit_interfaces_added(proxy->bus, object->path,
+                                             object->interface, NULL);
+      if (0 > ret) {
+        fprintf(stderr, "could not announce %s: (%s)\n", object->path,
+                strerror(-ret));
+      }
+      object->announced = true;
+      continue;
+    }
+
+    int ret = sd_bus_emit_properties_changed_strv(proxy->bus, object->path,
+                                                  object->interface, names);
+    if (0 > ret) {
+      fprintf(stderr, "could not emit changes of %s: (%s)\n", object->path,
+              strerror(-ret));
+    }
+  }
+}
+
+bool nora_proxy_set_string(char **field, const char *value) {
+  if (*field == value ||
+      (*field != NULL && value != NULL && strcmp(*field, value) == 0)) {
+    return false;
+  }
+
+  free(*field);
+  *field = value != NULL ? strdup(value) : NULL;
+  return true;
+}
+
+enum {
+  NORA_PROXY_EVENT_WAYLAND,
+  NORA_PROXY_EVENT_BUS,
+};
+
+static int epoll_update(int epoll_fd, int op, int fd, uint32_t events,
+                        uint64_t tag) {
+  struct epoll_event event = {.events = events, .data.u64 = tag};
+  if (epoll_ctl(epoll_fd, op, fd, &event) < 0) {
+    return -errno;
+  }
+
+  return 0;
+}
+
+// Converts the absolute CLOCK_MONOTONIC timeout of sd-bus to an epoll one.
+static int bus_timeout_msec(sd_bus *bus) {
+  uint64_t timeout_usec;
+  if (sd_bus_get_timeout(bus, &timeout_usec) < 0 ||
+      timeout_usec == UINT64_MAX) {
+    return -1;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t now_usec = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+  if (timeout_usec <= now_usec) {
+    return 0;
+  }
+
+  // Round up, waking up early would just spin.
+  return (timeout_usec - now_usec + 999) / 1000;
+}
+
+int nora_proxy_run(struct nora_proxy *proxy) {
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    return -errno;
+  }
+
+  int wayland_fd = wl_display_get_fd(proxy->display);
+  int bus_fd = sd_bus_get_fd(proxy->bus);
+
+  int ret = epoll_update(epoll_fd, EPOLL_CTL_ADD, wayland_fd, EPOLLIN,
+                         NORA_PROXY_EVENT_WAYLAND);
+  if (ret >= 0) {
+    ret = epoll_update(epoll_fd, EPOLL_CTL_ADD, bus_fd, 0,
+                       NORA_PROXY_EVENT_BUS);
+  }
+
+  uint32_t wayland_events = EPOLLIN;
+  while (ret >= 0) {
+    // D-Bus first, its method handlers queue up Wayland requests.
+    while ((ret = sd_bus_process(proxy->bus, NULL)) > 0) {
+    }
+    if (ret < 0) {
+      fprintf(stderr, "could not process bus: %s\n", strerror(-ret));
+      break;
+    }
+
+    // Events read along with a previous reply may still be queued.
+    while (wl_display_prepare_read(proxy->display) != 0) {
+      if (wl_display_dispatch_pending(proxy->display) < 0) {
+        ret = -errno;
+        break;
+      }
+    }
+    if (ret < 0) {
+      break;
+    }
+
+    // Wait for the socket to drain if the requests did not fit in.
+    uint32_t events = EPOLLIN;
+    if (wl_display_flush(proxy->display) < 0) {
+      if (errno != EAGAIN) {
+        ret = -errno;
+        wl_display_cancel_read(proxy->display);
+        break;
+      }
+      events |= EPOLLOUT;
+    }
+    if (events != wayland_events) {
+      ret = epoll_update(epoll_fd, EPOLL_CTL_MOD, wayland_fd, events,
+                         NORA_PROXY_EVENT_WAYLAND);
+      wayland_events = events;
+    }
+
+    int bus_events = sd_bus_get_events(proxy->bus);
+    if (ret >= 0 && bus_events >= 0) {
+      ret = epoll_update(epoll_fd, EPOLL_CTL_MOD, bus_fd, bus_events,
+                         NORA_PROXY_EVENT_BUS);
+    }
+    if (ret < 0 || bus_events < 0) {
+      ret = ret < 0 ? ret : bus_events;
+      wl_display_cancel_read(proxy->display);
+      break;
+    }
+
+    struct epoll_event ready[2];
+    int count = epoll_wait(epoll_fd, ready, 2, bus_timeout_msec(proxy->bus));
+    if (count < 0 && errno != EINTR) {
+      ret = -errno;
+      wl_display_cancel_read(proxy->display);
+      break;
+    }
+
+    bool readable = false;
+    for (int i = 0; i < count; ++i) {
+      if (ready[i].data.u64 == NORA_PROXY_EVENT_WAYLAND &&
+          (ready[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+        readable = true;
+      }
+    }
+
+    if (readable) {
+      if (wl_display_read_events(proxy->display) < 0) {
+        ret = -errno;
+        break;
+      }
+    } else {
+      wl_display_cancel_read(proxy->display);
+    }
+
+    if (wl_display_dispatch_pending(proxy->display) < 0) {
+      ret = -errno;
+      break;
+    }
+
+    nora_proxy_emit_changes(proxy);
+  }
+
+  close(epoll_fd);
+  return ret;
+}
+
 void nora_proxy_destroy(struct nora_proxy *proxy) {
   sd_bus_unref(proxy->bus);
 
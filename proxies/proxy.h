@@ -1,6 +1,7 @@
 #ifndef PROXIES_PROXY_H_
 #define PROXIES_PROXY_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <wayland-client-core.h>
 #include <wayland-client.h>
@@ -11,6 +12,24 @@
 
 #define TICKET_COUNT 64
 
+/* A D-Bus object whose property changes are collected and emitted as one
+ * PropertiesChanged signal.
+ */
+struct nora_proxy_object {
+  struct wl_list dirty_link; // nora_proxy::dirty
+
+  char *path;
+  const char *interface;
+  // Property names, indexed by the bits of changed.
+  const char *const *properties;
+  sd_bus_slot *slot;
+
+  uint32_t changed;
+  // InterfacesAdded was emitted, until then changes are not signaled on
+  // their own.
+  bool announced;
+};
+
 struct nora_interface_ticket {
   struct wl_interface wl_interface;
   uint32_t version;
@@ -27,11 +46,25 @@ struct nora_proxy {
 
   struct nora_interface_ticket tickets[TICKET_COUNT];
   size_t ticket_i;
+
+  struct wl_list dirty; // nora_proxy_object::dirty_link
 };
 
+// Root of every exported object, implements org.freedesktop.DBus.ObjectManager.
+#define NORA_PROXY_OBJECT_ROOT "/org/nora"
+
 struct nora_proxy *nora_proxy_create();
 void nora_proxy_destroy(struct nora_proxy *proxy);
 void nora_proxy_flush(struct nora_proxy *proxy);
+// Dispatches Wayland events and D-Bus messages as they arrive, sleeping in
+// between. Returns a negative errno once either connection fails.
+int nora_proxy_run(struct nora_proxy *proxy);
+
+/* Replies to the method call once the compositor has processed every
+ * request queued before it, e.g. the one the method forwarded. Returns what
+ * the sd-bus method handler should return. */
+int nora_proxy_reply_after_sync(struct nora_proxy *proxy,
+                                sd_bus_message *message);
 
 void nora_proxy_add_vtable(struct nora_proxy *proxy, const char *interface,
                            struct sd_bus_vtable *vtable);
@@ -41,4 +74,32 @@ void nora_proxy_bind(struct nora_proxy *proxy, struct wl_interface interface,
 void *nora_proxy_extract(struct nora_proxy *proxy,
                          struct wl_interface interface, uint32_t version);
 
+void nora_proxy_object_init(struct nora_proxy_object *object,
+                            const char *interface,
+                            const char *const *properties);
+void nora_proxy_object_finish(struct nora_proxy_object *object);
+// Exports the object at <prefix>/_<id> below the object manager. Ids must
+// never be reused, so clients can tell objects apart across removals. The
+// object is announced with InterfacesAdded on its first flush.
+int nora_proxy_object_add(struct nora_proxy *proxy,
+                          struct nora_proxy_object *object, const char *prefix,
+                          uint32_t id, const sd_bus_vtable *vtable,
+                          void *userdata);
+// Unexports the object, emitting InterfacesRemoved if it was announced.
+void nora_proxy_object_remove(struct nora_proxy *proxy,
+                              struct nora_proxy_object *object);
+// Records a changed property, it is emitted with the next flush of the
+// object.
+void nora_proxy_object_changed(struct nora_proxy_object *object,
+                               uint32_t property);
+// Queues the object's changes for the next nora_proxy_emit_changes, meant
+// for the end of a batch of Wayland events such as a done event.
+void nora_proxy_object_flush(struct nora_proxy *proxy,
+                             struct nora_proxy_object *object);
+// Emits one PropertiesChanged signal per flushed object.
+void nora_proxy_emit_changes(struct nora_proxy *proxy);
+
+// Replaces *field with a copy of value, returns whether it changed.
+bool nora_proxy_set_string(char **field, const char *value);
+
 #endif // PROXIES_PROXY_H_
\ No newline at end of file